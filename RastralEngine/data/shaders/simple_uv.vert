@@ -1,47 +1,78 @@
 #version 330 core
 
+// Permutations, defined by the engine after #version:
+//   SKINNED           palette skinning with MAX_INFLUENCES (1-4) joints, heaviest first
+//   INSTANCED         multi-draw: model, tint and palette come from the draw's
+//                     DrawRecord in uDrawRecords, picked by attribute 4
+#ifndef MAX_INFLUENCES
+#define MAX_INFLUENCES 4
+#endif
+
 layout(std140) uniform PerFrame {
     mat4 uProjView;
+    int  uDrawRecordBase;   // texel of the frame's first DrawRecord
 };
+#ifdef INSTANCED
+uniform samplerBuffer uDrawRecords;   // RGBA32F view of the uniform ring
+#else
 layout(std140) uniform PerDraw {
     mat4 uModel;
     vec4 uTint;
 };
+#endif
+#if defined(SKINNED) && !defined(INSTANCED)
 layout(std140) uniform Skin {
-    mat4 uBones[128];
-    int  uBoneCount; // unused by shader, but available
-    ivec3 _pad;
+    mat4 uBones[128];   // only the draw's bone count is uploaded
 };
+#endif
 
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec2 aUV;
-layout(location = 2) in vec4 aJoints;   // as floats; will round to ints
-layout(location = 3) in vec4 aWeights;  // weights
+#ifdef SKINNED
+layout(location = 2) in uvec4 aJoints;  // uint8 indices
+layout(location = 3) in vec4 aWeights;  // unorm8, sum to 1, sorted by weight
+#endif
+#ifdef INSTANCED
+layout(location = 4) in uint aDrawIndex;  // instanced 0, 1, 2, ... offset by baseInstance
+#endif
 
 out vec2 vUV;
 out vec4 vTint;
 
-void main() {
-    // Normalize weights defensively
-    vec4 w = aWeights;
-    float s = w.x + w.y + w.z + w.w;
-    if (s > 0.00001) w /= s; else w = vec4(1.0, 0.0, 0.0, 0.0);
-
-    ivec4 j = ivec4(round(aJoints));
+#ifdef INSTANCED
+mat4 fetchMat4(int texel) {
+    return mat4(texelFetch(uDrawRecords, texel),     texelFetch(uDrawRecords, texel + 1),
+                texelFetch(uDrawRecords, texel + 2), texelFetch(uDrawRecords, texel + 3));
+}
+#endif
 
-    // Fetch with bounds safety
-    mat4 B0 = (j.x >= 0 && j.x < 128) ? uBones[j.x] : mat4(1.0);
-    mat4 B1 = (j.y >= 0 && j.y < 128) ? uBones[j.y] : mat4(1.0);
-    mat4 B2 = (j.z >= 0 && j.z < 128) ? uBones[j.z] : mat4(1.0);
-    mat4 B3 = (j.w >= 0 && j.w < 128) ? uBones[j.w] : mat4(1.0);
+void main() {
+#ifdef INSTANCED
+    int  record = uDrawRecordBase + int(aDrawIndex) * 6;   // sizeof(DrawRecord) / 16
+    mat4 model  = fetchMat4(record);
+    vec4 tint   = texelFetch(uDrawRecords, record + 4);
+    ivec4 info  = floatBitsToInt(texelFetch(uDrawRecords, record + 5));   // palette texel, bone count
+#else
+    mat4 model  = uModel;
+    vec4 tint   = uTint;
+#endif
 
     vec4 p = vec4(aPos, 1.0);
-    vec4 skinned = (B0 * p) * w.x +
-                   (B1 * p) * w.y +
-                   (B2 * p) * w.z +
-                   (B3 * p) * w.w;
+#ifdef SKINNED
+    vec4 skinned = vec4(0.0);
+    for (int i = 0; i < MAX_INFLUENCES; ++i) {
+        uint j = aJoints[i];
+#ifdef INSTANCED
+        mat4 B = (int(j) < info.y) ? fetchMat4(info.x + int(j) * 4) : mat4(1.0);
+#else
+        mat4 B = (j < 128u) ? uBones[j] : mat4(1.0);   // bounds safety
+#endif
+        skinned += (B * p) * aWeights[i];
+    }
+    p = skinned;
+#endif
 
     vUV   = aUV;
-    vTint = uTint;
-    gl_Position = uProjView * uModel * skinned;
+    vTint = tint;
+    gl_Position = uProjView * model * p;
 }
@@ -17,7 +17,10 @@ layout(std140) uniform VizParams {
 
     vec4  uLevelsA;     // x=drums, y=bass, z=perc, w=synth
     float uLevelLead;
-    float _pad2[3];
+    float _pad1;
+    float _pad2;
+    float _pad3;
+    vec4  uSceneUV;     // xy=scale onto the scene's active rect, zw=max texcoord (dynamic resolution)
 };
 
 vec3 stateColor(int s){
@@ -29,7 +32,7 @@ vec3 stateColor(int s){
 
 void main() {
     // 1) base scene
-    vec4 scene = texture(uScene, vUV);
+    vec4 scene = texture(uScene, min(vUV * uSceneUV.xy, uSceneUV.zw));
 
     // 2) legacy geometry / envelope
     vec2 uv = vUV * 2.0 - 1.0;
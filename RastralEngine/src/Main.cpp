@@ -13,12 +13,18 @@
 #include <cfloat>
 
 #include "renderer.h"
+#include "memory_arena.cpp"
+#include "job_system.cpp"
 #include "opengl_renderer.cpp"
+#include "cpu_skinning.cpp"
+#include "culling.cpp"
+#include "draw_list.cpp"
+#include "mesh_optimizer.cpp"
 #include "gltf_loader.cpp"
 #include "MusicDirector.cpp"
 #include "windows_input.cpp"
 #include "engine_data.cpp"
-#include "memory_arena.cpp"
+#include "engine_bench.cpp"
 
 struct Win32Window {
     HINSTANCE hinst;
@@ -50,19 +56,30 @@ std::string gMeshShaderBase = "shaders/simple_uv";
 std::string gPostShaderBase = "shaders/visualizer";
 
 GLuint gTex_Albedo = 0;
-GLenum gMeshIndexType = GL_UNSIGNED_INT;
 Mat4 gModelPreXform = matIdentity();
 static int sAnimIdle = -1;
 static int sAnimDance1 = -1;
 static int sAnimDance2 = -1;
+static int sUpperBodyMask = -1;
+
+// Crowd members share the loaded asset; each one owns only an AnimInstance.
+#define CROWD_MAX 1024
+#define CROWD_SPACING 2.0f
+// Mesh LOD: full detail while the model's projected radius is at least this
+// many pixels, then one LOD coarser each time it halves.
+#define LOD_FULL_DETAIL_RADIUS_PX 128.0f
+static AnimInstance sCrowd[CROWD_MAX];
+static int sCrowdCreated = 0;
 
 // ---------- Animation externs from gltf_loader.cpp ----------
 namespace tinygltf { class Model; }
 extern const tinygltf::Model& GLTF_GetModel();
-extern void GLTF_UpdateAnimation_Pose(const tinygltf::Model& model, float tSec);
+struct AnimInstance; // already defined in gltf_loader.cpp
+extern void GLTF_UpdateAnimation_Pose(AnimInstance* inst, float tSec, FrameArena* scratch);
+extern void GLTF_UpdateAnimations(AnimInstance* instances, int count, float tSec, JobSystem* jobs);
 struct GLTFDraw; // already defined in gltf_loader.cpp
 extern std::vector<GLTFDraw> gGLTFDraws;
-extern void GLTF_GetBonesForDraw(const GLTFDraw& d, std::vector<float>& out16);
+extern const float* GLTF_GetDrawPalette(const AnimInstance* inst, const GLTFDraw& d);
 extern float gModelFitRadius; // from loader
 extern bool  gPlaceOnGround;  // from loader
 
@@ -126,9 +143,14 @@ bool GLCreateContextPreferCore(HDC hdc, GLContext& c) {
         return true;
     }
     if (wglCreateContextAttribsARB) {
-        const int attribs[] = { WGL_CONTEXT_MAJOR_VERSION_ARB,3, WGL_CONTEXT_MINOR_VERSION_ARB,3,
-                                WGL_CONTEXT_PROFILE_MASK_ARB, WGL_CONTEXT_CORE_PROFILE_BIT_ARB, 0 };
+        // 4.6 for buffer storage and friends; 3.3 is the minimum the shaders need.
+        int attribs[] = { WGL_CONTEXT_MAJOR_VERSION_ARB,4, WGL_CONTEXT_MINOR_VERSION_ARB,6,
+                          WGL_CONTEXT_PROFILE_MASK_ARB, WGL_CONTEXT_CORE_PROFILE_BIT_ARB, 0 };
         HGLRC core = wglCreateContextAttribsARB(hdc, 0, attribs);
+        if (!core) {
+            attribs[1] = 3; attribs[3] = 3;
+            core = wglCreateContextAttribsARB(hdc, 0, attribs);
+        }
         if (core) {
             wglMakeCurrent(nullptr, nullptr);
             wglDeleteContext(temp);
@@ -182,9 +204,11 @@ void UpdateWindowTitle() {
 
     char title[256];
     snprintf(title, sizeof(title),
-        "Rastral Engine | state=%s rage=%.2f vsync=%s | scale=%.3f dist=%.2f",
+        "Rastral Engine | state=%s rage=%.2f vsync=%s | scale=%.3f dist=%.2f crowd=%d draws=%d culled=%d calls=%d%s res=%d%%%s",
         StateName(md_get_state(&engineData->g_md)), engineData->g_rage, engineData->g_vsyncOn ? "on" : "off",
-        renderState->gUserScale, renderState->gCamDist);
+        renderState->gUserScale, renderState->gCamDist, renderState->gCrowdCount, renderState->gDrawsVisible, renderState->gDrawsCulled,
+        renderState->gDrawCalls, renderState->gMultiDraw ? " (mdi)" : "",
+        (int)(renderState->gSceneScale * 100.0f + 0.5f), renderState->gDynamicResolution ? " (dynamic)" : "");
     SetWindowTextA(g_win.hwnd, title);
 }
 
@@ -193,25 +217,78 @@ std::string ReadTextFile(const std::string& path) {
     std::ostringstream ss; ss << f.rdbuf(); return ss.str();
 }
 
+// simple_uv sources; GetMeshProgram builds variants of them with defines.
+static std::string sMeshVS, sMeshFS;
+// Draw indices sorted by program, then VAO and texture, so a frame
+// switches program once per variant; built with the programs.
+static std::vector<int> sDrawOrder;
+static int sProgramsBuilt = 0;
+
+// The program for a MeshShaderKey, compiled (or loaded from the binary
+// cache) on first use.
+GLuint GetMeshProgram(int key) {
+    GLuint& prog = renderState->gProgramMesh[key & (MESH_SHADER_PERMUTATIONS - 1)];
+    if (prog || sMeshVS.empty()) return prog;
+    const std::string defines = MeshShaderDefines(key);
+    const std::string vs = ShaderSourceWithDefines(sMeshVS, defines);
+    const std::string fs = ShaderSourceWithDefines(sMeshFS, defines);
+    prog = CreateProgramCached(vs.c_str(), fs.c_str());
+    InitMeshProgram(prog);
+    ++sProgramsBuilt;
+    return prog;
+}
+
+static bool DrawOrderLess(int a, int b) {
+    const GLTFDraw& da = gGLTFDraws[a];
+    const GLTFDraw& db = gGLTFDraws[b];
+    if (da.shaderKey != db.shaderKey) return da.shaderKey < db.shaderKey;
+    if (da.skinned != db.skinned) return da.skinned < db.skinned;
+    if (da.texture != db.texture) return da.texture < db.texture;
+    return a < b;
+}
+
+// Needs the model loaded: builds the variant each draw selects up front.
 void LoadShaders_FromFiles() {
-    const std::string vsMesh = ReadTextFile(gMeshShaderBase + ".vert");
-    const std::string fsMesh = ReadTextFile(gMeshShaderBase + ".frag");
+    HiResTimer t;
+    TimerStart(t);
+    CreateDirectoryA(gProgramCacheDir, nullptr);   // fails harmlessly when it exists
+    const int hits0 = g_programCache.hits, misses0 = g_programCache.misses, rejected0 = g_programCache.rejected;
+
+    sMeshVS = ReadTextFile(gMeshShaderBase + ".vert");
+    sMeshFS = ReadTextFile(gMeshShaderBase + ".frag");
     const std::string vsPost = ReadTextFile(gPostShaderBase + ".vert");
     const std::string fsPost = ReadTextFile(gPostShaderBase + ".frag");
-    if (vsMesh.empty() || fsMesh.empty() || vsPost.empty() || fsPost.empty()) {
+    if (sMeshVS.empty() || sMeshFS.empty() || vsPost.empty() || fsPost.empty()) {
         MessageBoxA(nullptr, "Missing shader source files.", "Shader Error", MB_ICONERROR);
         ExitProcess(1);
     }
-    DestroyProgram(renderState->gProgramMesh);
+    for (int k = 0; k < MESH_SHADER_PERMUTATIONS; ++k) DestroyProgram(renderState->gProgramMesh[k]);
     DestroyProgram(renderState->gProgramPost);
-    renderState->gProgramMesh = CreateProgramFromSources(vsMesh.c_str(), fsMesh.c_str());
-    renderState->gProgramPost = CreateProgramFromSources(vsPost.c_str(), fsPost.c_str());
-    if (!renderState->gProgramMesh || !renderState->gProgramPost) {
+    sProgramsBuilt = 0;
+
+    bool ok = true;
+    sDrawOrder.resize(gGLTFDraws.size());
+    for (size_t di = 0; di < gGLTFDraws.size(); ++di) {
+        sDrawOrder[di] = (int)di;
+        ok = GetMeshProgram(gGLTFDraws[di].shaderKey) != 0 && ok;
+        if (MultiDrawSupported()) ok = GetMeshProgram(gGLTFDraws[di].shaderKey | MESH_SHADER_INSTANCED) != 0 && ok;
+    }
+    std::sort(sDrawOrder.begin(), sDrawOrder.end(), DrawOrderLess);
+    renderState->gProgramPost = CreateProgramCached(vsPost.c_str(), fsPost.c_str());
+    ++sProgramsBuilt;
+    if (!ok || !renderState->gProgramPost) {
         MessageBoxA(nullptr, "Shader compile/link failed.", "Shader Error", MB_ICONERROR);
         ExitProcess(1);
     }
-    InitMeshProgram(renderState->gProgramMesh);
     InitPostProgram(renderState->gProgramPost);
+
+    // A launch with every program cached is "warm"; compare with a cold one
+    // (empty or stale cache) to see what the cache saves.
+    const int hits = g_programCache.hits - hits0;
+    const int compiled = (g_programCache.misses - misses0) + (g_programCache.rejected - rejected0);
+    std::printf("[shaders] %s start: %d programs in %.2f ms (%d cached, %d compiled%s)\n",
+        compiled == 0 && hits > 0 ? "warm" : "cold", sProgramsBuilt, NowSecs(t) * 1000.0f, hits, compiled,
+        g_programCache.supported ? "" : ", no program binary support");
 }
 
 void InitData() {
@@ -220,6 +297,8 @@ void InitData() {
     void* p2 = arena_alloc(&engineMemArena, sizeof(RenderState));
     engineData = new (p1) EngineData();
     renderState = new (p2) RenderState();
+    frame_arena_init(&frameScratchArena, &engineMemArena, FRAME_ARENA_SIZE);
+    job_system_init(&gJobs, 0, &engineMemArena);
 }
 
 bool InitAudio() {
@@ -296,22 +375,121 @@ static void ChooseAnimationSlots(float nowSec) {
     sAnimIdle = idle;
     sAnimDance1 = (d1 >= 0 ? d1 : idle);
     sAnimDance2 = (d2 >= 0 ? d2 : sAnimDance1);
+    sUpperBodyMask = GLTF_CreateBoneMask("upper body", "spine");
 
     // Start on idle
-    GLTF_SetActiveAnimationByIndex(sAnimIdle, nowSec);
+    GLTF_SetActiveAnimationByIndex(&sCrowd[0], sAnimIdle, nowSec);
+}
+
+// New members are created on demand from the engine arena and join in step
+// with member 0, so the whole crowd follows the MusicDirector cues together.
+static void SetCrowdCount(int count) {
+    if (count < 1) count = 1;
+    if (count > CROWD_MAX) count = CROWD_MAX;
+    while (sCrowdCreated < count && GLTF_CreateAnimInstance(&sCrowd[sCrowdCreated], &engineMemArena)) {
+        ++sCrowdCreated;
+    }
+    if (count > sCrowdCreated) count = sCrowdCreated;
+    for (int i = renderState->gCrowdCount; i < count; ++i) {
+        if (i > 0) GLTF_SyncAnimInstance(&sCrowd[i], &sCrowd[0]);
+    }
+    renderState->gCrowdCount = count;
+
+    const size_t bytes = GLTF_AnimInstanceBytes();
+    std::fprintf(stderr, "[crowd] %d instances, %zu bytes each (%.1f bytes/joint)\n",
+        count, bytes, (double)bytes / (double)(gHierarchy.count > 0 ? gHierarchy.count : 1));
+}
+
+static void CrossfadeCrowd(int clip, float startSec) {
+    for (int i = 0; i < renderState->gCrowdCount; ++i) {
+        GLTF_CrossfadeToAnimationByIndex(&sCrowd[i], clip, startSec, 0.35f, true);
+    }
+}
+
+// Overdrive grooves dance2's upper body over whatever the legs are doing.
+static void SetCrowdGroove(bool on, float startSec) {
+    if (sUpperBodyMask < 0) return;
+    for (int i = 0; i < renderState->gCrowdCount; ++i) {
+        int layer = GLTF_FindAnimLayer(&sCrowd[i], sAnimDance2, ABM_Override, sUpperBodyMask);
+        if (layer >= 0) GLTF_FadeAnimLayer(&sCrowd[i], layer, on ? 1.0f : 0.0f, startSec, 0.35f);
+        else if (on) GLTF_PushAnimLayer(&sCrowd[i], sAnimDance2, ABM_Override, sUpperBodyMask, 1.0f, startSec, 0.35f);
+    }
+}
+
+// Square grid around the model's origin; a crowd of one stays at the origin.
+static Mat4 CrowdOffset(int i, int count) {
+    int cols = (int)std::ceil(std::sqrt((float)count));
+    int rows = (count + cols - 1) / cols;
+    float x = ((float)(i % cols) - 0.5f * (float)(cols - 1)) * CROWD_SPACING;
+    float z = ((float)(i / cols) - 0.5f * (float)(rows - 1)) * CROWD_SPACING;
+    return Mat4Translate(x, 0.f, z);
+}
+
+// ---------- Dynamic resolution ----------
+// The scene pass renders into the top-left gSceneScale of gRT_Scene and the
+// post pass stretches that back over the window. Every DYNRES_INTERVAL frames
+// the scale is steered toward gFrameBudgetMs by the GPU time of the timed
+// passes (every profiler scope but the whole frame, which also counts the GPU
+// waiting on the CPU); without timer queries it stays put. Scene cost goes
+// roughly with pixel count, so the correction is sqrt(budget / measured), at
+// most DYNRES_MAX_STEP at a time and not at all inside the dead band.
+#define DYNRES_MIN_SCALE 0.5f
+#define DYNRES_INTERVAL  20
+#define DYNRES_MAX_STEP  0.1f
+#define DYNRES_DEADBAND  0.05f
+static float sGpuFrameMs = 0.f;   // smoothed
+static int   sDynResFrames = 0;
+
+static void UpdateSceneScale() {
+    if (!renderState->gDynamicResolution) return;
+    GpuScopeStats st;
+    float passMs = 0.f;
+    for (int i = 1; GpuProfilerGetScope(i, &st); ++i) passMs += st.lastMs;
+    if (passMs <= 0.f) return;
+    sGpuFrameMs = (sGpuFrameMs > 0.f) ? sGpuFrameMs + 0.15f * (passMs - sGpuFrameMs) : passMs;
+    if (++sDynResFrames < DYNRES_INTERVAL) return;
+    sDynResFrames = 0;
+
+    const float ratio = renderState->gFrameBudgetMs / std::max(sGpuFrameMs, 0.01f);
+    if (std::fabs(ratio - 1.0f) < DYNRES_DEADBAND) return;
+    const float cur = renderState->gSceneScale;
+    float next = cur * std::sqrt(ratio);
+    next = std::min(std::max(next, cur - DYNRES_MAX_STEP), cur + DYNRES_MAX_STEP);
+    renderState->gSceneScale = std::min(std::max(next, DYNRES_MIN_SCALE), 1.0f);
+}
+
+// LOD level for a model whose bounding sphere is centred at c, seen from eye
+// with vertical fov vfov on a viewH-pixel viewport; draws clamp it to their lodCount.
+static int SelectMeshLod(const float c[3], const float eye[3], float vfov, int viewH) {
+    const float dx = c[0] - eye[0], dy = c[1] - eye[1], dz = c[2] - eye[2];
+    const float dist = std::max(std::sqrt(dx * dx + dy * dy + dz * dz), 1e-3f);
+    float radiusPx = gModelFitRadius / (dist * std::tan(0.5f * vfov)) * 0.5f * (float)viewH;
+    int lod = 0;
+    while (radiusPx < LOD_FULL_DETAIL_RADIUS_PX && lod + 1 < GLTF_MAX_LODS) {
+        radiusPx *= 2.0f;
+        ++lod;
+    }
+    return lod;
 }
 
 void InitGraphics(int width, int height) {
     SetViewportSize(width, height);
-    LoadShaders_FromFiles();
 
     // NOTE: keeps your existing loader signature exactly as-is.
-    if (!CreateMeshFromGLTF_PosUV_Textured("models/idle-bot.glb", renderState->gVAO_Mesh, renderState->gVBO_Mesh, renderState->gEBO_Mesh, gModelPreXform)) {
+    if (!CreateMeshFromGLTF_PosUV_Textured("models/idle-bot.glb", renderState->gVAO_Mesh, renderState->gVBO_Mesh, renderState->gEBO_Mesh,
+            renderState->gVAO_MeshStatic, renderState->gVBO_MeshStatic, gModelPreXform)) {
         MessageBoxA(nullptr, "Failed to load models/idle-bot.glb", "glTF Load Error", MB_ICONERROR);
     }
 
     GLTF_AppendAnimationsFromFile("models/dance1.glb");
     GLTF_AppendAnimationsFromFile("models/dance2.glb");
+    // Workers pose whole instances in their scratch: size it to the skeleton, with headroom.
+    job_reserve_scratch(&gJobs, GLTF_PoseScratchBytes() + GLTF_PoseScratchBytes() / 4);
+    LoadShaders_FromFiles();
+    if (MultiDrawSupported()) {
+        AttachDrawIndexAttribute(renderState->gVAO_Mesh);
+        AttachDrawIndexAttribute(renderState->gVAO_MeshStatic);
+    }
 
     CreateFullscreenQuad(&renderState->gVAO_Post, &renderState->gVBO_Post);
     CreateRenderTarget(renderState->gRT_Scene, g_view_w, g_view_h);
@@ -332,17 +510,168 @@ void InitGraphics(int width, int height) {
     float aspect = (float)g_view_w / (float)g_view_h;
     float vfov = DegToRad(60.0f);
     renderState->gCamDist = DistanceToFitSphere(gModelFitRadius, vfov, aspect);
+    SetCrowdCount(1);
     ChooseAnimationSlots(0.0f);
 }
 
+// Scene submission one draw call per visible (member, draw), draw-major in
+// program order: one program, VAO and texture bind per draw, its visible
+// members inside with their own PerDraw block and Skin range.
+static void SubmitScenePerDraw(const Mat4& GlobalPre, int crowd, int members, const uint8_t* visible,
+        const UniformRange* paletteRanges, const int* lods) {
+    const int drawCount = (int)gGLTFDraws.size();
+    GLuint boundProgram = 0, boundVAO = 0;
+    for (int oi = 0; oi < (sDrawOrder.size() == (size_t)drawCount ? drawCount : 0); ++oi) {
+        const int di = sDrawOrder[oi];
+        const GLTFDraw& d = gGLTFDraws[di];
+        const GLuint program = renderState->gProgramMesh[d.shaderKey];
+        if (!program) continue;
+        bool bound = false;
+        for (int i = 0; i < members; ++i) {
+            if (!visible[i * drawCount + di]) continue;
+            if (!bound) {
+                if (program != boundProgram) { BeginShader(program); boundProgram = program; }
+                const GLuint vao = d.skinned ? renderState->gVAO_Mesh : renderState->gVAO_MeshStatic;
+                if (vao != boundVAO) { BindVAO(vao); boundVAO = vao; }
+                BindTexture2D(0, d.texture ? d.texture : gTex_Albedo);
+                bound = true;
+            }
+            // For skinned draws, glTF needs the mesh node’s world matrix too.
+            // uModel = GlobalPre * nodeWorld   (skinned)
+            // uModel = GlobalPre               (static; WM already baked into vertices)
+            const Mat4 InstPre = (crowd > 1) ? matMul(CrowdOffset(i, crowd), GlobalPre) : GlobalPre;
+            Mat4 Mdraw = d.skinned ? matMul(InstPre, d.localModel) : InstPre;
+
+            UpdatePerDrawUBO(Mdraw.m, d.baseColor);
+            if (d.skinned) BindSkinPalette(paletteRanges[i * drawCount + di]);
+
+            const GLTFDrawLod& range = d.lods[std::min(lods[i], d.lodCount - 1)];
+            DrawIndexedTriangles(range.indexCount, d.indexType, range.indexByteOffset, d.vertexOffset);
+            ++renderState->gDrawCalls;
+        }
+    }
+}
+
+// Scene submission through instancing and multi-draw indirect: a DrawRecord
+// per visible (member, draw), sorted by draw_list_key. Members drawing the
+// same primitive at the same LOD have equal keys and become one instanced
+// command over consecutive records, and every run of commands with the same
+// pipeline and texture is one glMultiDrawElementsIndirect. Returns false,
+// having drawn nothing, when the frame has to go per draw instead.
+static bool SubmitSceneMultiDraw(const Mat4& PV, const Mat4& GlobalPre, int crowd, int members, const uint8_t* visible,
+        const UniformRange* paletteRanges, const float* const* palettes, const int* lods) {
+    const int drawCount = (int)gGLTFDraws.size();
+    int count = 0;
+    for (int k = 0; k < members * drawCount; ++k) {
+        if (!visible[k]) continue;
+        if (!renderState->gProgramMesh[gGLTFDraws[k % drawCount].shaderKey | MESH_SHADER_INSTANCED]) return false;
+        ++count;
+    }
+    if (count == 0) return true;
+
+    uint64_t* keys = (uint64_t*)frame_arena_alloc(&frameScratchArena, (size_t)count * 2 * sizeof(uint64_t));
+    uint32_t* values = (uint32_t*)frame_arena_alloc(&frameScratchArena, (size_t)count * 2 * sizeof(uint32_t));
+    DrawRecord* records = (DrawRecord*)frame_arena_alloc(&frameScratchArena, (size_t)count * sizeof(DrawRecord));
+    DrawElementsIndirectCommand* commands = (DrawElementsIndirectCommand*)frame_arena_alloc(&frameScratchArena,
+        (size_t)count * sizeof(DrawElementsIndirectCommand));
+    if (!keys || !values || !records || !commands) return false;
+
+    // Pipeline: program variant, VAO (skinned) and index type; the mesh part
+    // is the primitive and its LOD, so a run of equal keys is one command.
+    int n = 0;
+    for (int k = 0; k < members * drawCount; ++k) {
+        if (!visible[k]) continue;
+        const int di = k % drawCount;
+        const GLTFDraw& d = gGLTFDraws[di];
+        const uint32_t pipeline = (uint32_t)d.shaderKey | (d.skinned ? 0x10u : 0u) | (d.indexType == GL_UNSIGNED_INT ? 0x20u : 0u);
+        const uint32_t mesh = ((uint32_t)di << 8) | (uint32_t)std::min(lods[k / drawCount], d.lodCount - 1);
+        keys[n] = draw_list_key(pipeline, d.texture ? d.texture : gTex_Albedo, mesh);
+        values[n] = (uint32_t)k;
+        ++n;
+    }
+    draw_list_sort(keys, values, keys + count, values + count, n);
+
+    GLuint paletteBuffer = 0;
+    bool oneBuffer = true;
+    int commandCount = 0;
+    for (int r = 0; r < n; ++r) {
+        const int k = (int)values[r];
+        const int i = k / drawCount;
+        const GLTFDraw& d = gGLTFDraws[k % drawCount];
+        const Mat4 InstPre = (crowd > 1) ? matMul(CrowdOffset(i, crowd), GlobalPre) : GlobalPre;
+        const Mat4 Mdraw = d.skinned ? matMul(InstPre, d.localModel) : InstPre;
+
+        DrawRecord& rec = records[r];
+        memcpy(rec.model, Mdraw.m, sizeof(rec.model));
+        memcpy(rec.tint, d.baseColor, sizeof(rec.tint));
+        rec.paletteTexel = -1;
+        rec.boneCount = 0;
+        rec._pad[0] = rec._pad[1] = 0;
+        if (d.skinned) {
+            rec.paletteTexel = FrameDataTexel(paletteRanges[k]);
+            rec.boneCount = palettes[k] ? std::min(d.boneCount, 128) : 1;   // identity palette otherwise
+            if (paletteBuffer && paletteRanges[k].buffer != paletteBuffer) oneBuffer = false;
+            paletteBuffer = paletteRanges[k].buffer;
+        }
+
+        if (r > 0 && keys[r] == keys[r - 1]) {
+            ++commands[commandCount - 1].instanceCount;
+            continue;
+        }
+        const GLTFDrawLod& range = d.lods[std::min(lods[i], d.lodCount - 1)];
+        DrawElementsIndirectCommand& cmd = commands[commandCount++];
+        cmd.count = (uint32_t)range.indexCount;
+        cmd.instanceCount = 1;
+        cmd.firstIndex = (uint32_t)(range.indexByteOffset / (d.indexType == GL_UNSIGNED_INT ? 4 : 2));
+        cmd.baseVertex = d.vertexOffset;
+        cmd.baseInstance = (uint32_t)r;   // records r.., through the draw index attribute
+        keys[commandCount - 1] = keys[r];   // commands reuse the front of the key and value lists
+        values[commandCount - 1] = values[r];
+    }
+
+    // Records, commands and palettes must share one ring buffer, which the
+    // record view and the indirect binding both point at.
+    EnsureDrawIndexCapacity(n);
+    const UniformRange recordRange = WriteFrameData(records, (GLsizeiptr)n * sizeof(DrawRecord));
+    const UniformRange commandRange = WriteFrameData(commands, (GLsizeiptr)commandCount * sizeof(DrawElementsIndirectCommand));
+    if (!oneBuffer || (paletteBuffer && paletteBuffer != recordRange.buffer) || commandRange.buffer != recordRange.buffer) return false;
+    if (!BindDrawRecords()) return false;
+    UpdatePerFrameUBO(PV.m, FrameDataTexel(recordRange));
+
+    GLuint boundProgram = 0, boundVAO = 0;
+    for (int first = 0; first < commandCount;) {
+        int last = first + 1;
+        while (last < commandCount && draw_list_same_batch(keys[first], keys[last])) ++last;
+        const GLTFDraw& d = gGLTFDraws[values[first] % drawCount];
+        const GLuint program = renderState->gProgramMesh[d.shaderKey | MESH_SHADER_INSTANCED];
+        if (program != boundProgram) { BeginShader(program); boundProgram = program; }
+        const GLuint vao = d.skinned ? renderState->gVAO_Mesh : renderState->gVAO_MeshStatic;
+        if (vao != boundVAO) { BindVAO(vao); boundVAO = vao; }
+        BindTexture2D(0, d.texture ? d.texture : gTex_Albedo);
+        MultiDrawIndexed(d.indexType, commandRange, first, last - first);
+        ++renderState->gDrawCalls;
+        first = last;
+    }
+    return true;
+}
+
 void RenderFrame(float tSeconds, int viewW, int viewH) {
+    const unsigned long long heapAllocsAtStart = debug_heap_alloc_count();
+    frame_arena_reset(&frameScratchArena);
+    job_system_reset_scratch(&gJobs);
     SetViewportSize(viewW, viewH);
+    GLStateBeginFrame();
+    BeginGpuFrame();
 
-    BeginRenderTarget(renderState->gRT_Scene);
-    BeginFrame(0.05f, 0.06f, 0.08f, 1.0f);
+    // The target only grows; the scale picks the rectangle drawn this frame.
+    UpdateSceneScale();
+    RenderTarget& sceneRT = renderState->gRT_Scene;
+    EnsureRenderTargetSize(sceneRT, g_view_w, g_view_h);
+    SetRenderTargetRect(sceneRT, (int)(g_view_w * renderState->gSceneScale + 0.5f), (int)(g_view_h * renderState->gSceneScale + 0.5f));
 
     float aspect = (float)g_view_w / (float)g_view_h;
-    Mat4 P = matPerspective(60.0f * 3.1415926f / 180.0f, aspect, 0.05f, 1000.0f);
+    const float vfov = 60.0f * 3.1415926f / 180.0f;
+    Mat4 P = matPerspective(vfov, aspect, 0.05f, 1000.0f);
 
     const float cp = std::cos(renderState->gPitch), sp = std::sin(renderState->gPitch);
     const float cy = std::cos(renderState->gYaw), sy = std::sin(renderState->gYaw);
@@ -359,41 +688,94 @@ void RenderFrame(float tSeconds, int viewW, int viewH) {
 
     Mat4 V = matLookAt(eyeX, eyeY, eyeZ, cx, cyT, cz, 0.0f, 1.0f, 0.0f);
     Mat4 PV = matMul(P, V);
-    UpdatePerFrameUBO(PV.m);
 
-    // Drive animation (idle) -> fills gGlobalsAnimated
-    GLTF_UpdateAnimation_Pose(GLTF_GetModel(), tSeconds);
+    // Worst case uniform bytes this frame: every draw's block and palette.
+    const int crowd = renderState->gCrowdCount;
+    const int drawCount = (int)gGLTFDraws.size();
+    GLsizeiptr uniformBytes = UniformBlockBytes(sizeof(PerFrameUBO)) + UniformBlockBytes(sizeof(VizParamsUBO)) + UniformBlockBytes(64);
+    for (int di = 0; di < drawCount; ++di)
+        uniformBytes += crowd * (UniformBlockBytes(sizeof(PerDrawUBO)) + UniformBlockBytes(gGLTFDraws[di].boneCount * 64));
+    if (renderState->gMultiDraw) {
+        const GLsizeiptr slotCount = (GLsizeiptr)crowd * drawCount;
+        uniformBytes += UniformBlockBytes(sizeof(PerFrameUBO)) + UniformBlockBytes(slotCount * sizeof(DrawRecord))
+            + UniformBlockBytes(slotCount * sizeof(DrawElementsIndirectCommand));
+    }
+    BeginUniformFrame(uniformBytes);
+    UpdatePerFrameUBO(PV.m);
 
-    BeginShader(renderState->gProgramMesh);
-    BindVAO(renderState->gVAO_Mesh);
+    // Drive animation -> fills each member's globals, spread across the job workers
+    GLTF_UpdateAnimations(sCrowd, crowd, tSeconds, &gJobs);
 
     const Mat4 GlobalPre = gModelPreXform;
-    std::vector<float> animBones;
-
-    for (const auto& d : gGLTFDraws) {
-        // For skinned draws, glTF needs the mesh node’s world matrix too.
-        // uModel = GlobalPre * nodeWorld   (skinned)
-        // uModel = GlobalPre               (static; WM already baked into vertices)
-        Mat4 Mdraw = d.skinned ? matMul(GlobalPre, d.localModel) : GlobalPre;
-
-        const float* bones = nullptr;
-        if (d.boneCount > 0) {
-            GLTF_GetBonesForDraw(d, animBones);   // yields (jointWorld * inverseBind)
-            bones = animBones.data();
+
+    // World box of every member's draws, skinned ones from the current
+    // palette, then one frustum pass before any uniform or draw work.
+    const size_t slots = (size_t)crowd * drawCount + 1;
+    UniformRange* paletteRanges = (UniformRange*)frame_arena_alloc(&frameScratchArena, slots * sizeof(UniformRange));
+    const float** palettes = (const float**)frame_arena_alloc(&frameScratchArena, slots * sizeof(const float*));
+    float* boxData = (float*)frame_arena_alloc(&frameScratchArena, slots * 6 * sizeof(float));
+    uint8_t* visible = (uint8_t*)frame_arena_alloc(&frameScratchArena, slots);
+    const int drawn = (paletteRanges && palettes && boxData && visible) ? crowd : 0;
+    CullBoxes boxes = { boxData, boxData + slots, boxData + 2 * slots, boxData + 3 * slots, boxData + 4 * slots, boxData + 5 * slots };
+    for (int i = 0; i < drawn; ++i) {
+        const Mat4 InstPre = (crowd > 1) ? matMul(CrowdOffset(i, crowd), GlobalPre) : GlobalPre;
+        for (int di = 0; di < drawCount; ++di) {
+            const GLTFDraw& d = gGLTFDraws[di];
+            const int k = i * drawCount + di;
+            palettes[k] = (d.boneCount <= 128) ? GLTF_GetDrawPalette(&sCrowd[i], d) : nullptr;   // (jointWorld * inverseBind)
+
+            const Mat4 Mdraw = d.skinned ? matMul(InstPre, d.localModel) : InstPre;
+            float lo[3], hi[3], mn[3], mx[3];
+            if (!d.skinned) {
+                cull_transform_aabb(Mdraw.m, d.boundsMin, d.boundsMax, mn, mx);
+            }
+            else if (palettes[k] && cull_skinned_aabb(d.jointBounds.data(), d.boneCount, palettes[k], lo, hi)) {
+                cull_transform_aabb(Mdraw.m, lo, hi, mn, mx);
+            }
+            else {
+                mn[0] = mn[1] = mn[2] = -1e30f;   // no palette to bound it by; always drawn
+                mx[0] = mx[1] = mx[2] = 1e30f;
+            }
+            cull_boxes_set(&boxes, k, mn, mx);
         }
+    }
+    CullFrustum frustum;
+    cull_extract_frustum(PV.m, &frustum);
+    const int visibleDraws = cull_boxes(frustum, boxes, drawn * drawCount, visible);
+    renderState->gDrawsVisible = visibleDraws;
+    renderState->gDrawsCulled = drawn * drawCount - visibleDraws;
 
-        UpdatePerDrawUBO(Mdraw.m, d.baseColor);
-        UpdateSkinUBO(bones, d.boneCount);
+    // Write every visible palette first (shared skins and in-step crowd
+    // members dedupe), then draws only rebind a range.
+    BeginSkinPalettes(visibleDraws);
+    for (int k = 0; k < drawn * drawCount; ++k) {
+        if (visible[k] && gGLTFDraws[k % drawCount].skinned) paletteRanges[k] = PushSkinPalette(palettes[k], gGLTFDraws[k % drawCount].boneCount);
+    }
 
-        BindTexture2D(0, d.texture ? d.texture : gTex_Albedo);
-        DrawIndexedTriangles(d.indexCount, (void*)(d.indexOffset * sizeof(uint32_t)));
+    // Timed from here so the CPU work above doesn't count as GPU time.
+    const int sceneScope = GpuScopeBegin("scene");
+    BeginRenderTarget(sceneRT);
+    ClearFrame(0.05f, 0.06f, 0.08f, 1.0f);
+
+    // LOD per member, then the instanced multi-draw path, or per draw.
+    int* lods = (int*)frame_arena_alloc(&frameScratchArena, (size_t)crowd * sizeof(int) + sizeof(int));
+    const int sorted = (lods && sDrawOrder.size() == (size_t)drawCount) ? drawn : 0;
+    for (int i = 0; i < sorted; ++i) {
+        const Mat4 Offset = CrowdOffset(i, crowd);
+        const float center[3] = { gModelTarget[0] + Offset.m[12], gModelTarget[1] + Offset.m[13], gModelTarget[2] + Offset.m[14] };
+        const float eye[3] = { eyeX, eyeY, eyeZ };
+        lods[i] = SelectMeshLod(center, eye, vfov, sceneRT.vh);
     }
 
-    BindVAO(0);
-    BindTexture2D(0, 0);
-    EndShader();
+    renderState->gDrawCalls = 0;
+    const bool multiDraw = sorted && renderState->gMultiDraw && MultiDrawSupported() &&
+        SubmitSceneMultiDraw(PV, GlobalPre, crowd, sorted, visible, paletteRanges, palettes, lods);
+
+    if (sorted && !multiDraw) SubmitScenePerDraw(GlobalPre, crowd, sorted, visible, paletteRanges, lods);
 
+    // No unbinds: the post pass rebinds program, VAO and unit 0 right away.
     EndRenderTarget();
+    GpuScopeEnd(sceneScope);
 
     // --- post pass (unchanged) ---
     float beatPhase = 0.f, barPhase = 0.f; md_music_clock(&engineData->g_md, &beatPhase, &barPhase);
@@ -404,17 +786,29 @@ void RenderFrame(float tSeconds, int viewW, int viewH) {
     float vLead = md_get_stem_current_volume(&engineData->g_md, "lead");
     int   stateI = (int)md_get_state(&engineData->g_md);
 
+    const int postScope = GpuScopeBegin("post");
     BeginFrame(0, 0, 0, 1);
     BeginShader(renderState->gProgramPost);
+    float sceneUV[4]; RenderTargetSampleRect(sceneRT, sceneUV);
     UpdateVizParamsUBO((float)g_view_w, (float)g_view_h, tSeconds, beatPhase, barPhase, stateI, engineData->g_rage,
-        vDrums, vBass, vPerc, vSynth, vLead);
-    BindTexture2D(0, renderState->gRT_Scene.color);
+        vDrums, vBass, vPerc, vSynth, vLead, sceneUV);
+    BindTexture2D(0, sceneRT.color);
     BindVAO(renderState->gVAO_Post);
     DrawTriangles(0, 6);
     BindVAO(0);
     BindTexture2D(0, 0);
     EndShader();
+    GpuScopeEnd(postScope);
     EndFrame();
+    EndGpuFrame();
+    EndUniformFrame();
+
+    // Debug builds: after warm-up a frame must not touch the heap.
+    renderState->gFrameHeapAllocs = debug_heap_alloc_count() - heapAllocsAtStart;
+    if (++renderState->gFrameCount > 2 && renderState->gFrameHeapAllocs > 0) {
+        std::fprintf(stderr, "[alloc] frame %llu made %llu heap allocations\n",
+            renderState->gFrameCount, renderState->gFrameHeapAllocs);
+    }
 }
 
 void HandleInput() {
@@ -482,6 +876,17 @@ void HandleInput() {
         renderState->gPitch = DegToRad(-20.0f);
     }
 
+    if (Input_IsPressed('D')) {
+        renderState->gDynamicResolution = !renderState->gDynamicResolution;
+        if (!renderState->gDynamicResolution) renderState->gSceneScale = 1.0f;
+        UpdateWindowTitle();
+    }
+
+    if (Input_IsPressed('M')) {
+        renderState->gMultiDraw = !renderState->gMultiDraw;
+        UpdateWindowTitle();
+    }
+
     if (Input_IsPressed('R')) {
         renderState->gUserScale = 1.0f;
         renderState->gCamDist = 3.0f;
@@ -493,25 +898,39 @@ void HandleInput() {
     if (Input_IsPressed('1')) {
         uint64_t when = md_set_state(&engineData->g_md, MD_Calm, true, 300.0f);
         double delaySec = md_delay_sec_from_when(&engineData->g_md, when);
-        GLTF_CrossfadeToAnimationByIndex(sAnimIdle, now + (float)delaySec, 0.35f, true);
+        CrossfadeCrowd(sAnimIdle, now + (float)delaySec);
+        SetCrowdGroove(false, now + (float)delaySec);
     }
 
     if (Input_IsPressed('2')) {
         uint64_t when = md_set_state(&engineData->g_md, MD_Tense, true, 300.0f);
         double delaySec = md_delay_sec_from_when(&engineData->g_md, when);
-        GLTF_CrossfadeToAnimationByIndex(sAnimDance1, now + (float)delaySec, 0.35f, true);
+        CrossfadeCrowd(sAnimDance1, now + (float)delaySec);
+        SetCrowdGroove(false, now + (float)delaySec);
     }
 
     if (Input_IsPressed('3')) {
         uint64_t when = md_set_state(&engineData->g_md, MD_Combat, true, 350.0f);
         double delaySec = md_delay_sec_from_when(&engineData->g_md, when);
-        GLTF_CrossfadeToAnimationByIndex(sAnimDance2, now + (float)delaySec, 0.35f, true);
+        CrossfadeCrowd(sAnimDance2, now + (float)delaySec);
+        SetCrowdGroove(false, now + (float)delaySec);
     }
 
     if (Input_IsPressed('4')) {
         uint64_t when = md_set_state(&engineData->g_md, MD_Overdrive, true, 400.0f);
         double delaySec = md_delay_sec_from_when(&engineData->g_md, when);
-        GLTF_CrossfadeToAnimationByIndex(sAnimDance2, now + (float)delaySec, 0.35f, true);
+        CrossfadeCrowd(sAnimDance1, now + (float)delaySec);
+        SetCrowdGroove(true, now + (float)delaySec);
+    }
+
+    if (Input_IsPressed(VK_PRIOR)) {
+        SetCrowdCount(renderState->gCrowdCount * 2);
+        UpdateWindowTitle();
+    }
+
+    if (Input_IsPressed(VK_NEXT)) {
+        SetCrowdCount(renderState->gCrowdCount / 2);
+        UpdateWindowTitle();
     }
 
     if (Input_IsPressed(VK_OEM_MINUS)) {
@@ -621,7 +1040,10 @@ bool Win32CreateWindowSimple(Win32Window& w) {
     return true;
 }
 
-extern "C" int APIENTRY WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int) {
+extern "C" int APIENTRY WinMain(HINSTANCE hInst, HINSTANCE, LPSTR cmdLine, int) {
+    // Benchmarks run against the loaded scene, without audio or the frame loop.
+    const bool benchMode = cmdLine && std::strstr(cmdLine, "--bench");
+
     g_win.hinst = hInst;
     g_win.width = 1280;
     g_win.height = 720;
@@ -642,13 +1064,18 @@ extern "C" int APIENTRY WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int) {
     SetSwapInterval(1);
 
     InitData();
-    if (!InitAudio()) {
+    if (!benchMode && !InitAudio()) {
         MessageBoxA(nullptr, "Audio init failed.", "Error", MB_ICONERROR);
         return 2;
     }
 
 
     InitGraphics(g_win.width, g_win.height);
+    if (benchMode) {
+        int rc = Bench_RunAll(cmdLine);
+        job_system_shutdown(&gJobs);
+        return rc;
+    }
 
     Input_Init();
     UpdateWindowTitle();
@@ -672,7 +1099,10 @@ extern "C" int APIENTRY WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int) {
             md_update(&engineData->g_md, dt);
         }
 
+        const int visibleBefore = renderState->gDrawsVisible;
+        const float scaleBefore = renderState->gSceneScale;
         RenderFrame(now, g_win.width, g_win.height);
+        if (renderState->gDrawsVisible != visibleBefore || renderState->gSceneScale != scaleBefore) UpdateWindowTitle();
         SwapBuffers(g_win.hdc);
         if (!engineData->g_vsyncOn) {
             using namespace std::chrono;
@@ -687,8 +1117,8 @@ extern "C" int APIENTRY WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int) {
         }
     }
 
-    if (renderState->gProgramMesh) {
-        DestroyProgram(renderState->gProgramMesh);
+    for (int k = 0; k < MESH_SHADER_PERMUTATIONS; ++k) {
+        DestroyProgram(renderState->gProgramMesh[k]);
     }
 
     if (renderState->gProgramPost) {
@@ -707,6 +1137,14 @@ extern "C" int APIENTRY WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int) {
         glDeleteBuffers(1, &renderState->gEBO_Mesh);
     }
 
+    if (renderState->gVAO_MeshStatic) {
+        glDeleteVertexArrays(1, &renderState->gVAO_MeshStatic);
+    }
+
+    if (renderState->gVBO_MeshStatic) {
+        glDeleteBuffers(1, &renderState->gVBO_MeshStatic);
+    }
+
     if (renderState->gVAO_Post) {
         glDeleteVertexArrays(1, &renderState->gVAO_Post);
     }
@@ -719,8 +1157,11 @@ extern "C" int APIENTRY WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int) {
         DestroyTexture(gTex_Albedo);
     }
 
+    DestroyMultiDraw();
     DestroyUBOs();
+    DestroyGpuProfiler();
 
+    job_system_shutdown(&gJobs);
     ShutdownAudio();
     wglMakeCurrent(nullptr, nullptr);
     if (g_gl.rc)
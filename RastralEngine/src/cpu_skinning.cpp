@@ -0,0 +1,162 @@
+#include <cstddef>
+#include "math_helper.h"
+#include "renderer.h"
+
+// ============================================================
+// CPU skinning of the loader's skinned vertex stream (SkinnedVertex, see
+// CreateMeshFromGLTF_PosUV_Textured) against a palette from
+// GLTF_GetBonesForDraw. Output is xyz per vertex in the same space the
+// vertex shader skins into, before uModel. For headless runs, exports and
+// picking against animated geometry.
+//
+// Weights are unorm8 and sum to 255 (the loader does it); they decode as
+// w / 255 like GL's normalized fetch. Joint indices outside the palette skin
+// with identity, like the shader. Zero-weight influences are skipped. Every
+// path transforms by each influence and sums in order 0..3 with separate
+// multiply and add, so SIMD and scalar results are identical.
+
+#define SKIN_JOB_GRAIN 2048   // vertices per job
+
+static const float kSkinIdentity[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+
+static inline const float* skin_bone(const float* palette16, int boneCount, int joint)
+{
+    return (joint < boneCount) ? palette16 + (size_t)joint * 16 : kSkinIdentity;
+}
+
+static inline float skin_weight(uint8_t w)
+{
+    return (float)w / 255.f;
+}
+
+void skin_positions_scalar(const SkinnedVertex* verts, int count, const float* palette16, int boneCount, float* outXYZ)
+{
+    for (int v = 0; v < count; ++v)
+    {
+        const SkinnedVertex* src = verts + v;
+        const float x = src->pos[0], y = src->pos[1], z = src->pos[2];
+        float acc[3] = { 0.f, 0.f, 0.f };
+        for (int i = 0; i < 4; ++i)
+        {
+            if (src->weights[i] == 0)
+                continue;
+            const float w = skin_weight(src->weights[i]);
+            const float* B = skin_bone(palette16, boneCount, src->joints[i]);
+            for (int r = 0; r < 3; ++r)
+            {
+                float p = B[0 + r] * x + B[4 + r] * y + B[8 + r] * z + B[12 + r];
+                acc[r] = acc[r] + p * w;
+            }
+        }
+        float* dst = outXYZ + (size_t)v * 3;
+        dst[0] = acc[0]; dst[1] = acc[1]; dst[2] = acc[2];
+    }
+}
+
+#if defined(MATH_SIMD_SSE)
+// One vertex per iteration: the palette is column-major, so a bone's four
+// columns load straight into registers.
+void skin_positions_sse(const SkinnedVertex* verts, int count, const float* palette16, int boneCount, float* outXYZ)
+{
+    for (int v = 0; v < count; ++v)
+    {
+        const SkinnedVertex* src = verts + v;
+        const __m128 x = _mm_set1_ps(src->pos[0]), y = _mm_set1_ps(src->pos[1]), z = _mm_set1_ps(src->pos[2]);
+        __m128 acc = _mm_setzero_ps();
+        for (int i = 0; i < 4; ++i)
+        {
+            if (src->weights[i] == 0)
+                continue;
+            const float* B = skin_bone(palette16, boneCount, src->joints[i]);
+            __m128 p = _mm_mul_ps(_mm_loadu_ps(B + 0), x);
+            p = _mm_add_ps(p, _mm_mul_ps(_mm_loadu_ps(B + 4), y));
+            p = _mm_add_ps(p, _mm_mul_ps(_mm_loadu_ps(B + 8), z));
+            p = _mm_add_ps(p, _mm_loadu_ps(B + 12));
+            acc = _mm_add_ps(acc, _mm_mul_ps(p, _mm_set1_ps(skin_weight(src->weights[i]))));
+        }
+        float* dst = outXYZ + (size_t)v * 3;
+        _mm_storel_pi((__m64*)dst, acc);
+        _mm_store_ss(dst + 2, _mm_movehl_ps(acc, acc));
+    }
+}
+#endif
+
+#if defined(MATH_SIMD_AVX2)
+static inline __m256 skin_load_pair(const float* a, const float* b)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)), _mm_loadu_ps(b), 1);
+}
+
+static inline __m256 skin_splat_pair(float a, float b)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(a)), _mm_set1_ps(b), 1);
+}
+
+// Two vertices per iteration, one per 128-bit lane.
+void skin_positions_avx2(const SkinnedVertex* verts, int count, const float* palette16, int boneCount, float* outXYZ)
+{
+    int v = 0;
+    for (; v + 2 <= count; v += 2)
+    {
+        const SkinnedVertex* s0 = verts + v;
+        const SkinnedVertex* s1 = s0 + 1;
+        const __m256 x = skin_splat_pair(s0->pos[0], s1->pos[0]);
+        const __m256 y = skin_splat_pair(s0->pos[1], s1->pos[1]);
+        const __m256 z = skin_splat_pair(s0->pos[2], s1->pos[2]);
+        __m256 acc = _mm256_setzero_ps();
+        for (int i = 0; i < 4; ++i)
+        {
+            if (s0->weights[i] == 0 && s1->weights[i] == 0)
+                continue;
+            const float* B0 = skin_bone(palette16, boneCount, s0->joints[i]);
+            const float* B1 = skin_bone(palette16, boneCount, s1->joints[i]);
+            __m256 p = _mm256_mul_ps(skin_load_pair(B0 + 0, B1 + 0), x);
+            p = _mm256_add_ps(p, _mm256_mul_ps(skin_load_pair(B0 + 4, B1 + 4), y));
+            p = _mm256_add_ps(p, _mm256_mul_ps(skin_load_pair(B0 + 8, B1 + 8), z));
+            p = _mm256_add_ps(p, skin_load_pair(B0 + 12, B1 + 12));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(p, skin_splat_pair(skin_weight(s0->weights[i]), skin_weight(s1->weights[i]))));
+        }
+        const __m128 lo = _mm256_castps256_ps128(acc), hi = _mm256_extractf128_ps(acc, 1);
+        float* dst = outXYZ + (size_t)v * 3;
+        _mm_storel_pi((__m64*)dst, lo);
+        _mm_store_ss(dst + 2, _mm_movehl_ps(lo, lo));
+        _mm_storel_pi((__m64*)(dst + 3), hi);
+        _mm_store_ss(dst + 5, _mm_movehl_ps(hi, hi));
+    }
+    if (v < count)
+        skin_positions_sse(verts + v, count - v, palette16, boneCount, outXYZ + (size_t)v * 3);
+}
+#endif
+
+// Best kernel compiled in.
+void skin_positions(const SkinnedVertex* verts, int count, const float* palette16, int boneCount, float* outXYZ)
+{
+#if defined(MATH_SIMD_AVX2)
+    skin_positions_avx2(verts, count, palette16, boneCount, outXYZ);
+#elif defined(MATH_SIMD_SSE)
+    skin_positions_sse(verts, count, palette16, boneCount, outXYZ);
+#else
+    skin_positions_scalar(verts, count, palette16, boneCount, outXYZ);
+#endif
+}
+
+struct SkinBatch
+{
+    const SkinnedVertex* verts;
+    const float*         palette16;
+    int                  boneCount;
+    float*               outXYZ;
+};
+
+static void skin_job(void* data, int begin, int end, int worker)
+{
+    SkinBatch* b = (SkinBatch*)data;
+    skin_positions(b->verts + begin, end - begin, b->palette16, b->boneCount, b->outXYZ + (size_t)begin * 3);
+}
+
+// Splits the vertices across the job workers and waits for all of them.
+void skin_positions_parallel(JobSystem* js, const SkinnedVertex* verts, int count, const float* palette16, int boneCount, float* outXYZ)
+{
+    SkinBatch batch = { verts, palette16, boneCount, outXYZ };
+    job_parallel_for(js, count, SKIN_JOB_GRAIN, skin_job, &batch);
+}
@@ -0,0 +1,176 @@
+#include <cstddef>
+#include <cstdint>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include "math_helper.h"
+
+// ============================================================
+// View frustum culling. Boxes are axis aligned, given as centre and
+// half-extent in structure-of-arrays form so the SIMD kernel tests four per
+// iteration. A box is culled when it lies entirely on the outside of any of
+// the six planes; boxes straddling a corner outside the frustum but not
+// wholly behind one plane are kept (conservative). Every path evaluates the
+// plane distance in the same order, so SIMD and scalar results are identical.
+//
+// Bounds come from the loader (GLTFDraw bounds and per-joint boxes) and are
+// taken to world space here: static draws by their model matrix, skinned
+// draws through the current palette first.
+
+struct CullFrustum
+{
+    float planes[6][4];   // a, b, c, d with ax + by + cz + d >= 0 inside, normals unit length
+};
+
+struct CullBoxes
+{
+    float* cx; float* cy; float* cz;   // centre
+    float* ex; float* ey; float* ez;   // half-extent
+};
+
+// Planes of a column-major clip-from-world matrix (Gribb & Hartmann).
+void cull_extract_frustum(const float* pv16, CullFrustum* out)
+{
+    // Row r of the matrix is (m[r], m[4 + r], m[8 + r], m[12 + r]).
+    for (int p = 0; p < 6; ++p)
+    {
+        const int r = p >> 1;
+        const float sign = (p & 1) ? -1.f : 1.f;
+        float pl[4];
+        for (int c = 0; c < 4; ++c) pl[c] = pv16[c * 4 + 3] + sign * pv16[c * 4 + r];
+        const float len = std::sqrt(pl[0] * pl[0] + pl[1] * pl[1] + pl[2] * pl[2]);
+        const float inv = (len > 0.f) ? 1.f / len : 0.f;
+        for (int c = 0; c < 4; ++c) out->planes[p][c] = pl[c] * inv;
+    }
+}
+
+// Box min/max through an affine column-major matrix, as a box again (Arvo).
+void cull_transform_aabb(const float* m16, const float mn[3], const float mx[3], float outMin[3], float outMax[3])
+{
+    for (int r = 0; r < 3; ++r)
+    {
+        float lo = m16[12 + r], hi = m16[12 + r];
+        for (int c = 0; c < 3; ++c)
+        {
+            const float a = m16[c * 4 + r] * mn[c];
+            const float b = m16[c * 4 + r] * mx[c];
+            lo += (a < b) ? a : b;
+            hi += (a < b) ? b : a;
+        }
+        outMin[r] = lo;
+        outMax[r] = hi;
+    }
+}
+
+// A skinned vertex is a weighted average of its joints' transforms, so it
+// stays inside the union of each joint's box (min xyz, max xyz of the
+// vertices it influences, min > max when none) taken through that joint's
+// palette matrix. Returns false when no joint has vertices.
+bool cull_skinned_aabb(const float* jointBounds, int jointCount, const float* palette16, float outMin[3], float outMax[3])
+{
+    bool any = false;
+    outMin[0] = outMin[1] = outMin[2] = FLT_MAX;
+    outMax[0] = outMax[1] = outMax[2] = -FLT_MAX;
+    for (int j = 0; j < jointCount; ++j)
+    {
+        const float* b = jointBounds + (size_t)j * 6;
+        if (b[0] > b[3]) continue;
+        float lo[3], hi[3];
+        cull_transform_aabb(palette16 + (size_t)j * 16, b, b + 3, lo, hi);
+        for (int k = 0; k < 3; ++k)
+        {
+            outMin[k] = std::min(outMin[k], lo[k]);
+            outMax[k] = std::max(outMax[k], hi[k]);
+        }
+        any = true;
+    }
+    return any;
+}
+
+void cull_boxes_set(CullBoxes* boxes, int i, const float mn[3], const float mx[3])
+{
+    boxes->cx[i] = 0.5f * (mn[0] + mx[0]); boxes->ex[i] = 0.5f * (mx[0] - mn[0]);
+    boxes->cy[i] = 0.5f * (mn[1] + mx[1]); boxes->ey[i] = 0.5f * (mx[1] - mn[1]);
+    boxes->cz[i] = 0.5f * (mn[2] + mx[2]); boxes->ez[i] = 0.5f * (mx[2] - mn[2]);
+}
+
+// visible[i] = 1 if box i may be in the frustum; returns the visible count.
+int cull_boxes_scalar(const CullFrustum& f, const CullBoxes& b, int begin, int end, uint8_t* visible)
+{
+    int count = 0;
+    for (int i = begin; i < end; ++i)
+    {
+        uint8_t in = 1;
+        for (int p = 0; p < 6; ++p)
+        {
+            const float* pl = f.planes[p];
+            float d = pl[0] * b.cx[i];
+            d = d + pl[1] * b.cy[i];
+            d = d + pl[2] * b.cz[i];
+            d = d + pl[3];
+            d = d + std::fabs(pl[0]) * b.ex[i];
+            d = d + std::fabs(pl[1]) * b.ey[i];
+            d = d + std::fabs(pl[2]) * b.ez[i];
+            if (d < 0.f) in = 0;
+        }
+        visible[i] = in;
+        count += in;
+    }
+    return count;
+}
+
+#if defined(MATH_SIMD_SSE)
+// Four boxes per iteration against each plane in turn; the tail goes scalar.
+int cull_boxes_sse(const CullFrustum& f, const CullBoxes& b, int count, uint8_t* visible)
+{
+    __m128 pa[6], pb[6], pc[6], pd[6], aa[6], ab[6], ac[6];
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    for (int p = 0; p < 6; ++p)
+    {
+        pa[p] = _mm_set1_ps(f.planes[p][0]);
+        pb[p] = _mm_set1_ps(f.planes[p][1]);
+        pc[p] = _mm_set1_ps(f.planes[p][2]);
+        pd[p] = _mm_set1_ps(f.planes[p][3]);
+        aa[p] = _mm_and_ps(pa[p], absMask);
+        ab[p] = _mm_and_ps(pb[p], absMask);
+        ac[p] = _mm_and_ps(pc[p], absMask);
+    }
+
+    int visibleCount = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 cx = _mm_loadu_ps(b.cx + i), cy = _mm_loadu_ps(b.cy + i), cz = _mm_loadu_ps(b.cz + i);
+        const __m128 ex = _mm_loadu_ps(b.ex + i), ey = _mm_loadu_ps(b.ey + i), ez = _mm_loadu_ps(b.ez + i);
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 d = _mm_mul_ps(pa[p], cx);
+            d = _mm_add_ps(d, _mm_mul_ps(pb[p], cy));
+            d = _mm_add_ps(d, _mm_mul_ps(pc[p], cz));
+            d = _mm_add_ps(d, pd[p]);
+            d = _mm_add_ps(d, _mm_mul_ps(aa[p], ex));
+            d = _mm_add_ps(d, _mm_mul_ps(ab[p], ey));
+            d = _mm_add_ps(d, _mm_mul_ps(ac[p], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+        }
+        const int mask = _mm_movemask_ps(outside);
+        for (int k = 0; k < 4; ++k)
+        {
+            visible[i + k] = (uint8_t)(((mask >> k) & 1) ^ 1);
+            visibleCount += visible[i + k];
+        }
+    }
+    return visibleCount + cull_boxes_scalar(f, b, i, count, visible);
+}
+#endif
+
+// Best kernel compiled in.
+int cull_boxes(const CullFrustum& f, const CullBoxes& b, int count, uint8_t* visible)
+{
+#if defined(MATH_SIMD_SSE)
+    return cull_boxes_sse(f, b, count, visible);
+#else
+    return cull_boxes_scalar(f, b, 0, count, visible);
+#endif
+}
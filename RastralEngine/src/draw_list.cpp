@@ -0,0 +1,64 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// ============================================================
+// Draw list ordering. Each visible draw gets a 64-bit key:
+//   bits 56..63  pipeline: program variant, vertex layout, index type
+//   bits 32..55  texture name
+//   bits  0..31  mesh: primitive and LOD
+// and the list is sorted by a stable LSD radix sort, eight bits per pass.
+// Draws with equal keys are instances of one command, and keys that agree
+// above DRAW_LIST_BATCH_SHIFT can go in one multi-draw call; the original
+// order breaks ties, so instances keep their order.
+
+#define DRAW_LIST_BATCH_SHIFT 32
+
+uint64_t draw_list_key(uint32_t pipeline, uint32_t texture, uint32_t mesh)
+{
+    return ((uint64_t)(pipeline & 0xFFu) << 56) | ((uint64_t)(texture & 0xFFFFFFu) << 32) | (uint64_t)mesh;
+}
+
+// True when a and b can be submitted in the same batch.
+bool draw_list_same_batch(uint64_t a, uint64_t b)
+{
+    return (a >> DRAW_LIST_BATCH_SHIFT) == (b >> DRAW_LIST_BATCH_SHIFT);
+}
+
+// Sorts keys ascending, carrying values along. tmpKeys and tmpValues hold
+// count entries each; the result always ends up back in keys and values.
+// A pass whose digit is the same for every key is skipped.
+void draw_list_sort(uint64_t* keys, uint32_t* values, uint64_t* tmpKeys, uint32_t* tmpValues, int count)
+{
+    if (count < 2) return;
+    uint64_t* srcK = keys;     uint32_t* srcV = values;
+    uint64_t* dstK = tmpKeys;  uint32_t* dstV = tmpValues;
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        uint32_t histogram[256];
+        std::memset(histogram, 0, sizeof(histogram));
+        for (int i = 0; i < count; ++i) ++histogram[(srcK[i] >> shift) & 0xFF];
+        if (histogram[(srcK[0] >> shift) & 0xFF] == (uint32_t)count) continue;
+
+        uint32_t sum = 0;
+        for (int d = 0; d < 256; ++d)
+        {
+            const uint32_t n = histogram[d];
+            histogram[d] = sum;
+            sum += n;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            const uint32_t at = histogram[(srcK[i] >> shift) & 0xFF]++;
+            dstK[at] = srcK[i];
+            dstV[at] = srcV[i];
+        }
+        uint64_t* tk = srcK; srcK = dstK; dstK = tk;
+        uint32_t* tv = srcV; srcV = dstV; dstV = tv;
+    }
+    if (srcK != keys)
+    {
+        std::memcpy(keys, srcK, (size_t)count * sizeof(uint64_t));
+        std::memcpy(values, srcV, (size_t)count * sizeof(uint32_t));
+    }
+}
@@ -0,0 +1,1110 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <string>
+
+// ============================================================
+// Offline benchmarks. Run with `MusicDirector.exe --bench` for all of
+// them, or `--bench <name> ...` to pick some; results go to stdout. They run
+// after the scene is loaded, without audio or the frame loop.
+
+double Bench_NowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+bool Bench_Wants(const char* args, const char* name) {
+    const char* rest = std::strstr(args, "--bench");
+    if (!rest) return false;
+    rest += 7;
+    while (*rest == ' ') ++rest;
+    return *rest == 0 || std::strstr(rest, name) != NULL;
+}
+
+// Keeps the optimizer from discarding benchmark results.
+volatile float gBenchSink = 0.f;
+
+// ============================================================
+// Keyframe lookup: cursor vs. the old linear scan from key 1
+static void Bench_SampleVec3Linear(const float* times, const float* vals, uint32_t count, float t, float out[3]) {
+    if (t <= times[0]) { out[0] = vals[0]; out[1] = vals[1]; out[2] = vals[2]; return; }
+    if (t >= times[count - 1]) { const float* v = vals + (size_t)(count - 1) * 3; out[0] = v[0]; out[1] = v[1]; out[2] = v[2]; return; }
+    uint32_t i = 1; while (i < count && t > times[i]) ++i; uint32_t i0 = i - 1, i1 = i;
+    float u = (t - times[i0]) / std::max(1e-6f, times[i1] - times[i0]);
+    for (int c = 0; c < 3; ++c) { float a = vals[i0 * 3 + c], b = vals[i1 * 3 + c]; out[c] = a * (1.f - u) + b * u; }
+}
+
+void Bench_KeyframeLookup() {
+    // 30 Hz keys played back at 60 fps from 8 seek points spread over the clip.
+    const uint32_t sizes[] = { 32, 256, 2048, 16384, 131072 };
+    const int seeks = 8;
+    const int framesPerSeek = 4096;
+    const float dt = 1.f / 60.f;
+
+    std::printf("[bench] keyframe lookup, ns per vec3 sample\n");
+    std::printf("  %8s %10s %10s\n", "keys", "linear", "cursor");
+    for (size_t si = 0; si < sizeof(sizes) / sizeof(sizes[0]); ++si) {
+        const uint32_t n = sizes[si];
+        std::vector<float> times(n), vals((size_t)n * 3);
+        for (uint32_t k = 0; k < n; ++k) {
+            times[k] = (float)k / 30.f;
+            vals[k * 3 + 0] = std::sin(0.10f * k); vals[k * 3 + 1] = std::cos(0.07f * k); vals[k * 3 + 2] = 0.01f * (float)(k % 97);
+        }
+        const float dur = times[n - 1];
+        float acc = 0.f;
+
+        double t0 = Bench_NowMs();
+        for (int s = 0; s < seeks; ++s) {
+            float t = dur * (float)s / (float)seeks;
+            for (int f = 0; f < framesPerSeek; ++f) {
+                float v[3]; Bench_SampleVec3Linear(times.data(), vals.data(), n, std::fmod(t, dur), v);
+                acc += v[0]; t += dt;
+            }
+        }
+        double t1 = Bench_NowMs();
+        uint32_t cursor = 0;
+        for (int s = 0; s < seeks; ++s) {
+            float t = dur * (float)s / (float)seeks;
+            for (int f = 0; f < framesPerSeek; ++f) {
+                float v[3]; sampleVec3(times.data(), vals.data(), n, std::fmod(t, dur), v, false, cursor);
+                acc += v[0]; t += dt;
+            }
+        }
+        double t2 = Bench_NowMs();
+        gBenchSink = acc;
+
+        const double samples = (double)seeks * framesPerSeek;
+        std::printf("  %8u %10.1f %10.1f\n", n, (t1 - t0) * 1e6 / samples, (t2 - t1) * 1e6 / samples);
+    }
+}
+
+// ============================================================
+// Math kernels: SIMD matMul / direct TRS / Affine3x4 vs. the scalar originals
+static Mat4 Bench_MatTRSCompose(float tx, float ty, float tz, float qx, float qy, float qz, float qw, float sx, float sy, float sz) {
+    return matMulScalar(Mat4Translate(tx, ty, tz), matMulScalar(matFromQuat(qx, qy, qz, qw), matScale(sx, sy, sz)));
+}
+
+void Bench_MathKernels() {
+#if defined(MATH_SIMD_AVX2)
+    const char* path = "AVX2";
+#elif defined(MATH_SIMD_SSE)
+    const char* path = "SSE2";
+#else
+    const char* path = "scalar";
+#endif
+    // A 64-joint palette: joint globals times inverse binds, as in skinning.
+    const int J = 64;
+    const int reps = 20000;
+    std::vector<float> trs((size_t)J * 10);
+    std::vector<Mat4> G((size_t)J), IB((size_t)J), out((size_t)J);
+    std::vector<Affine3x4> Ga((size_t)J), IBa((size_t)J), outA((size_t)J);
+    for (int j = 0; j < J; ++j) {
+        float* p = &trs[(size_t)j * 10];
+        float qx = std::sin(0.3f * j), qy = std::cos(0.7f * j), qz = 0.2f, qw = 1.f;
+        float L = std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+        p[0] = 0.1f * j; p[1] = 0.05f; p[2] = -0.02f * j; p[3] = qx / L; p[4] = qy / L; p[5] = qz / L; p[6] = qw / L; p[7] = p[8] = p[9] = 1.f + 0.01f * j;
+        G[(size_t)j] = matTRS(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9]);
+        IB[(size_t)j] = matTRS(-p[0], 0.3f, 0.1f, p[4], p[3], p[6], p[5], 1.f, 1.f, 1.f);
+        Ga[(size_t)j] = affineFromMat4(G[(size_t)j]);
+        IBa[(size_t)j] = affineFromMat4(IB[(size_t)j]);
+    }
+    float acc = 0.f;
+    double perOp = 1e6 / ((double)reps * J);
+
+    double t0 = Bench_NowMs();
+    for (int r = 0; r < reps; ++r) for (int j = 0; j < J; ++j) out[(size_t)j] = matMulScalar(G[(size_t)j], IB[(size_t)j]);
+    acc += out[(size_t)J - 1].m[5];
+    double t1 = Bench_NowMs();
+    for (int r = 0; r < reps; ++r) for (int j = 0; j < J; ++j) out[(size_t)j] = matMul(G[(size_t)j], IB[(size_t)j]);
+    acc += out[(size_t)J - 1].m[5];
+    double t2 = Bench_NowMs();
+    for (int r = 0; r < reps; ++r) for (int j = 0; j < J; ++j) outA[(size_t)j] = affineMul(Ga[(size_t)j], IBa[(size_t)j]);
+    acc += outA[(size_t)J - 1].m[5];
+    double t3 = Bench_NowMs();
+
+    for (int r = 0; r < reps; ++r) for (int j = 0; j < J; ++j) {
+        const float* p = &trs[(size_t)j * 10];
+        out[(size_t)j] = Bench_MatTRSCompose(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9]);
+    }
+    acc += out[(size_t)J - 1].m[5];
+    double t4 = Bench_NowMs();
+    for (int r = 0; r < reps; ++r) for (int j = 0; j < J; ++j) {
+        const float* p = &trs[(size_t)j * 10];
+        out[(size_t)j] = matTRS(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9]);
+    }
+    acc += out[(size_t)J - 1].m[5];
+    double t5 = Bench_NowMs();
+    for (int r = 0; r < reps; ++r) for (int j = 0; j < J; ++j) {
+        const float* p = &trs[(size_t)j * 10];
+        outA[(size_t)j] = affineTRS(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9]);
+    }
+    acc += outA[(size_t)J - 1].m[5];
+    double t6 = Bench_NowMs();
+    gBenchSink = acc;
+
+    // Cross-check the fast paths against the originals.
+    float maxErr = 0.f;
+    for (int j = 0; j < J; ++j) {
+        const float* p = &trs[(size_t)j * 10];
+        Mat4 a = matMulScalar(G[(size_t)j], IB[(size_t)j]), b = matMul(G[(size_t)j], IB[(size_t)j]);
+        Mat4 c = affineToMat4(affineMul(Ga[(size_t)j], IBa[(size_t)j]));
+        Mat4 d = Bench_MatTRSCompose(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9]);
+        Mat4 e = matTRS(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9]);
+        Mat4 f = affineToMat4(affineTRS(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9]));
+        for (int k = 0; k < 16; ++k) {
+            maxErr = std::max(maxErr, std::fabs(a.m[k] - b.m[k]));
+            maxErr = std::max(maxErr, std::fabs(a.m[k] - c.m[k]));
+            maxErr = std::max(maxErr, std::fabs(d.m[k] - e.m[k]));
+            maxErr = std::max(maxErr, std::fabs(d.m[k] - f.m[k]));
+        }
+    }
+
+    std::printf("[bench] math kernels (%s), ns per op, %d joints x %d reps\n", path, J, reps);
+    std::printf("  palette multiply   matMulScalar %6.2f  matMul %6.2f  affineMul %6.2f\n", (t1 - t0) * perOp, (t2 - t1) * perOp, (t3 - t2) * perOp);
+    std::printf("  TRS to matrix      T*(R*S)      %6.2f  matTRS %6.2f  affineTRS %6.2f\n", (t4 - t3) * perOp, (t5 - t4) * perOp, (t6 - t5) * perOp);
+    std::printf("  max abs difference vs. originals: %g\n", maxErr);
+}
+
+// ============================================================
+// Job system: crowd pose evaluation on 1..N workers
+#define BENCH_CROWD 256
+
+void Bench_JobScaling() {
+    if (gHierarchy.count == 0 || gAnims.empty()) {
+        std::printf("[bench] jobs: no animated model loaded\n");
+        return;
+    }
+    const int C = BENCH_CROWD;
+    const int frames = 120;
+    static AnimInstance crowd[BENCH_CROWD];
+    int created = 0;
+    while (created < C && GLTF_CreateAnimInstance(&crowd[created], &engineMemArena)) {
+        // Spread the crowd over clips and phases so the work isn't identical.
+        GLTF_SetActiveAnimationByIndex(&crowd[created], created % (int)gAnims.size(), -0.037f * (float)created);
+        ++created;
+    }
+
+    int maxWorkers = (int)std::thread::hardware_concurrency();
+    if (maxWorkers < 1) maxWorkers = 1;
+    if (maxWorkers > JOB_MAX_WORKERS) maxWorkers = JOB_MAX_WORKERS;
+
+    std::printf("[bench] job system, %d instances x %d joints, ms per frame\n", created, gHierarchy.count);
+    std::printf("  %8s %10s %10s\n", "workers", "ms", "speedup");
+    job_system_shutdown(&gJobs);
+    double base = 0.0;
+    for (int w = 1; w <= maxWorkers; ++w) {
+        job_system_init(&gJobs, w, &engineMemArena);
+        for (int f = 0; f < 10; ++f) GLTF_UpdateAnimations(crowd, created, (float)f / 60.f, &gJobs);
+        double t0 = Bench_NowMs();
+        for (int f = 0; f < frames; ++f) {
+            job_system_reset_scratch(&gJobs);
+            GLTF_UpdateAnimations(crowd, created, 1.f + (float)f / 60.f, &gJobs);
+        }
+        double ms = (Bench_NowMs() - t0) / frames;
+        job_system_shutdown(&gJobs);
+        if (w == 1) base = ms;
+        std::printf("  %8d %10.3f %9.2fx\n", w, ms, base / ms);
+    }
+    job_system_init(&gJobs, 0, &engineMemArena);
+
+    for (int i = 0; i < created; ++i) GLTF_DestroyAnimInstance(&crowd[i], &engineMemArena);
+}
+
+// ============================================================
+// Clip compression: size, sampling cost and max error vs. the float path.
+// Returns the number of clips whose error exceeds the configured bounds
+// plus quantization slack, so `--bench clips` doubles as a regression check.
+#define BENCH_POS_SLACK_STEPS 1.0f   // quantization: half a step per component, rounded up
+#define BENCH_ANGLE_SLACK 2e-4f      // 15-bit smallest-three quantization
+
+static float Bench_MaxPoseError(const float* a, const float* b, int count, float maxErr[3]) {
+    const size_t N = (size_t)count;
+    for (size_t i = 0; i < N; ++i) {
+        float ta[3] = { a[PS_TX * N + i], a[PS_TY * N + i], a[PS_TZ * N + i] }, tb[3] = { b[PS_TX * N + i], b[PS_TY * N + i], b[PS_TZ * N + i] };
+        float qa[4] = { a[PS_QX * N + i], a[PS_QY * N + i], a[PS_QZ * N + i], a[PS_QW * N + i] }, qb[4] = { b[PS_QX * N + i], b[PS_QY * N + i], b[PS_QZ * N + i], b[PS_QW * N + i] };
+        float sa[3] = { a[PS_SX * N + i], a[PS_SY * N + i], a[PS_SZ * N + i] }, sb[3] = { b[PS_SX * N + i], b[PS_SY * N + i], b[PS_SZ * N + i] };
+        maxErr[0] = std::max(maxErr[0], AnimValueError(AP_Translation, ta, tb));
+        maxErr[1] = std::max(maxErr[1], AnimValueError(AP_Rotation, qa, qb));
+        maxErr[2] = std::max(maxErr[2], AnimValueError(AP_Scale, sa, sb));
+    }
+    return maxErr[0];
+}
+
+int Bench_ClipCompression() {
+    if (gHierarchy.count == 0) {
+        std::printf("[bench] clips: no model loaded\n");
+        return 0;
+    }
+    const char* files[] = { "models/idle-bot.glb", "models/dance1.glb", "models/dance2.glb" };
+    const AnimCompressionSettings& S = gAnimCompression;
+    const size_t N = (size_t)gHierarchy.count;
+    std::vector<float> poseA(N * POSE_STREAMS), poseB(N * POSE_STREAMS);
+    std::vector<Affine3x4> globA(N), globB(N);
+    int failures = 0;
+
+    std::printf("[bench] clip compression, bounds: pos %g, angle %g rad, scale %g\n", S.maxPositionError, S.maxAngleError, S.maxScaleError);
+    std::printf("  %-18s %10s %10s %6s %8s %8s %10s %10s %10s %10s\n", "clip", "raw B", "packed B", "ratio", "raw ns", "pack ns", "max pos", "max rad", "max scale", "world pos");
+    for (size_t fi = 0; fi < sizeof(files) / sizeof(files[0]); ++fi) {
+        std::vector<GLTFAnimation> clips;
+        if (!GLTF_DecodeAnimationsFromFile(files[fi], clips)) continue;
+        for (size_t ci = 0; ci < clips.size(); ++ci) {
+            const GLTFAnimation& raw = clips[ci];
+            GLTFAnimation packed;
+            CompressAnimation(raw, gHierarchy, S, packed);
+
+            // Quantization slack for translation: half a step on each axis of the coarsest track.
+            float posSlack = 0.f;
+            for (size_t ch = 0; ch < packed.channels.size(); ++ch) {
+                const AnimChannel& C = packed.channels[ch];
+                if (C.path != AP_Translation) continue;
+                posSlack = std::max(posSlack, 0.5f * std::sqrt(C.qStep[0] * C.qStep[0] + C.qStep[1] * C.qStep[1] + C.qStep[2] * C.qStep[2]));
+            }
+            posSlack *= 2.f * BENCH_POS_SLACK_STEPS;
+
+            // Error on a 240 Hz grid, finer than the source keys.
+            std::vector<uint32_t> curA(raw.channels.size(), 0u), curB(packed.channels.size(), 0u);
+            float maxErr[3] = { 0.f, 0.f, 0.f };
+            float worldErr = 0.f;
+            const int steps = std::max(1, (int)(raw.durationSec * 240.f));
+            for (int k = 0; k <= steps; ++k) {
+                float t = raw.durationSec * (float)k / (float)steps;
+                SampleAnimationPose(raw, t, curA.data(), poseA.data());
+                SampleAnimationPose(packed, t, curB.data(), poseB.data());
+                Bench_MaxPoseError(poseA.data(), poseB.data(), gHierarchy.count, maxErr);
+                ComputeGlobalTransforms(gHierarchy, poseA.data(), globA.data());
+                ComputeGlobalTransforms(gHierarchy, poseB.data(), globB.data());
+                for (size_t i = 0; i < N; ++i) {
+                    float a[3] = { globA[i].m[3], globA[i].m[7], globA[i].m[11] }, b[3] = { globB[i].m[3], globB[i].m[7], globB[i].m[11] };
+                    worldErr = std::max(worldErr, AnimValueError(AP_Translation, a, b));
+                }
+            }
+
+            // Sampling cost per pose at 60 fps playback.
+            const int frames = 2048;
+            double t0 = Bench_NowMs();
+            for (int f = 0; f < frames; ++f) SampleAnimationPose(raw, std::fmod((float)f / 60.f, raw.durationSec), curA.data(), poseA.data());
+            double t1 = Bench_NowMs();
+            for (int f = 0; f < frames; ++f) SampleAnimationPose(packed, std::fmod((float)f / 60.f, raw.durationSec), curB.data(), poseB.data());
+            double t2 = Bench_NowMs();
+            gBenchSink = poseA[0] + poseB[0];
+
+            const size_t rawBytes = GLTF_AnimationBytes(raw), packedBytes = GLTF_AnimationBytes(packed);
+            const bool ok = maxErr[0] <= S.maxPositionError + posSlack &&
+                maxErr[1] <= S.maxAngleError + BENCH_ANGLE_SLACK &&
+                maxErr[2] <= S.maxScaleError + 1e-4f;
+            if (!ok) ++failures;
+
+            char label[19];
+            std::snprintf(label, sizeof(label), "%s", files[fi] + 7);
+            std::printf("  %-18s %10zu %10zu %5.1fx %8.0f %8.0f %10.5f %10.6f %10.6f %10.5f%s\n", label, rawBytes, packedBytes,
+                (double)rawBytes / (double)std::max<size_t>(1, packedBytes), (t1 - t0) * 1e6 / frames, (t2 - t1) * 1e6 / frames,
+                maxErr[0], maxErr[1], maxErr[2], worldErr, ok ? "" : "  FAIL");
+        }
+    }
+    return failures;
+}
+
+// ============================================================
+// Blend layers: the layer evaluator vs. sampling and blending full poses.
+// Returns the number of setups whose output differs from the full-pose
+// reference by more than BENCH_LAYER_TOLERANCE, so `--bench layers` is also
+// a regression check.
+#define BENCH_LAYER_TOLERANCE 1e-3f
+
+// Every slot of both clips is sampled, then pose1 blends over pose0 by w * mask.
+static void Bench_FullPoseBlend(const GLTFAnimation& A0, float t0, uint32_t* cur0, const GLTFAnimation& A1, float t1, uint32_t* cur1,
+                                const BoneMask* M, float w, float* pose0, float* pose1, Affine3x4* globals) {
+    const size_t N = (size_t)gHierarchy.count;
+    SampleAnimationPose(A0, t0, cur0, pose0);
+    SampleAnimationPose(A1, t1, cur1, pose1);
+    for (size_t i = 0; i < N; ++i) {
+        float wm = M ? w * M->weight[i] : w;
+        if (wm <= 0.f) continue;
+        for (int p = AP_Translation; p <= AP_Scale; ++p) {
+            const float* src = pose1 + PoseStreamBase((AnimPath)p, N) + i;
+            float v[4] = { src[0], src[N], src[2 * N], (p == AP_Rotation) ? src[3 * N] : 0.f };
+            BlendPoseValue(pose0, N, i, (AnimPath)p, v, wm);
+        }
+    }
+    ComputeGlobalTransforms(gHierarchy, pose0, globals);
+}
+
+static size_t Bench_MaskedChannels(const GLTFAnimation& A, const BoneMask* M) {
+    size_t n = 0;
+    for (size_t ch = 0; ch < A.channels.size(); ++ch) if (!M || M->weight[(size_t)A.channels[ch].targetSlot] > 0.f) ++n;
+    return n;
+}
+
+int Bench_BlendLayers() {
+    if (gHierarchy.count == 0 || gAnims.size() < 2) {
+        std::printf("[bench] layers: needs a model with two clips\n");
+        return 0;
+    }
+    const int mask = GLTF_CreateBoneMask("bench upper body", "spine");
+    if (mask < 0) {
+        std::printf("[bench] layers: no spine joint to mask from\n");
+        return 0;
+    }
+    const BoneMask* M = &gBoneMasks[(size_t)mask];
+    const GLTFAnimation& A0 = gAnims[0];
+    const GLTFAnimation& A1 = gAnims[1];
+    const GLTFAnimation& A2 = gAnims[gAnims.size() > 2 ? 2 : 0];
+    const size_t N = (size_t)gHierarchy.count;
+    std::vector<float> pose0(N * POSE_STREAMS), pose1(N * POSE_STREAMS);
+    std::vector<Affine3x4> ref(N);
+    std::vector<uint32_t> cur0(gMaxClipChannels, 0u), cur1(gMaxClipChannels, 0u);
+    const int frames = 2048;
+    const float fadeDur = 2.f * (float)frames / 60.f;   // crossfade stays mid-blend for the whole run
+    const char* names[] = { "base only", "crossfade", "upper-body override", "upper-body + additive", "zero-weight layer" };
+    int failures = 0;
+
+    std::printf("[bench] blend layers, %d joints, upper-body mask %zu slots, ns per instance update\n", gHierarchy.count, M->slots.size());
+    std::printf("  %-22s %7s %9s %10s %10s %10s\n", "setup", "layers", "channels", "layered", "full pose", "max diff");
+    for (int setup = 0; setup < 5; ++setup) {
+        AnimInstance inst;
+        if (!GLTF_CreateAnimInstance(&inst, &engineMemArena)) break;
+        GLTF_SetActiveAnimationByIndex(&inst, 0, 0.f);
+        size_t channels = A0.channels.size();
+        if (setup == 1) {
+            GLTF_CrossfadeToAnimationByIndex(&inst, 1, 0.f, fadeDur, false);
+            channels += A1.channels.size();
+        }
+        if (setup == 2 || setup == 3) {
+            GLTF_PushAnimLayer(&inst, 1, ABM_Override, mask, 1.f, 0.f, 0.f);
+            channels += Bench_MaskedChannels(A1, M);
+        }
+        if (setup == 3) {
+            GLTF_PushAnimLayer(&inst, gAnims.size() > 2 ? 2 : 0, ABM_Additive, -1, 0.5f, 0.f, 0.f);
+            channels += A2.channels.size();
+        }
+        if (setup == 4) {
+            // Fades in far in the future, so its weight stays 0.
+            GLTF_PushAnimLayer(&inst, 1, ABM_Override, -1, 1.f, 1e9f, 1.f);
+        }
+        const bool hasRef = (setup == 1 || setup == 2 || setup == 4);
+        const BoneMask* refMask = (setup == 2) ? M : NULL;
+
+        double t0 = Bench_NowMs();
+        for (int f = 0; f < frames; ++f) {
+            frame_arena_reset(&frameScratchArena);
+            GLTF_UpdateAnimation_Pose(&inst, (float)f / 60.f, &frameScratchArena);
+        }
+        double t1 = Bench_NowMs();
+        if (hasRef) {
+            for (int f = 0; f < frames; ++f) {
+                float t = (float)f / 60.f;
+                float w = (setup == 1) ? t / fadeDur : (setup == 2) ? 1.f : 0.f;
+                Bench_FullPoseBlend(A0, std::fmod(t, A0.durationSec), cur0.data(), A1, std::fmod(t, A1.durationSec), cur1.data(),
+                    refMask, w, pose0.data(), pose1.data(), ref.data());
+            }
+        }
+        double t2 = Bench_NowMs();
+        gBenchSink = inst.globals[0].m[3] + ref[0].m[3];
+
+        float maxDiff = 0.f;
+        if (hasRef) {
+            for (int f = 0; f < frames; f += 17) {
+                float t = (float)f / 60.f;
+                float w = (setup == 1) ? t / fadeDur : (setup == 2) ? 1.f : 0.f;
+                frame_arena_reset(&frameScratchArena);
+                GLTF_UpdateAnimation_Pose(&inst, t, &frameScratchArena);
+                Bench_FullPoseBlend(A0, std::fmod(t, A0.durationSec), cur0.data(), A1, std::fmod(t, A1.durationSec), cur1.data(),
+                    refMask, w, pose0.data(), pose1.data(), ref.data());
+                for (size_t i = 0; i < N; ++i)
+                    for (int k = 0; k < 12; ++k) maxDiff = std::max(maxDiff, std::fabs(inst.globals[i].m[k] - ref[i].m[k]));
+            }
+        }
+        const bool ok = maxDiff <= BENCH_LAYER_TOLERANCE;
+        if (!ok) ++failures;
+
+        if (hasRef) {
+            std::printf("  %-22s %7d %9zu %10.0f %10.0f %10.2g%s\n", names[setup], GLTF_GetAnimLayerCount(&inst), channels,
+                (t1 - t0) * 1e6 / frames, (t2 - t1) * 1e6 / frames, maxDiff, ok ? "" : "  FAIL");
+        }
+        else {
+            std::printf("  %-22s %7d %9zu %10.0f %10s %10s\n", names[setup], GLTF_GetAnimLayerCount(&inst), channels, (t1 - t0) * 1e6 / frames, "-", "-");
+        }
+        GLTF_DestroyAnimInstance(&inst, &engineMemArena);
+    }
+
+    // A push onto a full stack must never evict the topmost base, nor a base
+    // under it mid-crossfade; with nothing evictable it is refused.
+    const char* evictNames[] = { "base + 3 layers", "crossfade + 2 layers", "4 bases fading in" };
+    for (int setup = 0; setup < 3; ++setup) {
+        AnimInstance inst;
+        if (!GLTF_CreateAnimInstance(&inst, &engineMemArena)) break;
+        GLTF_SetActiveAnimationByIndex(&inst, 0, 0.f);
+        if (setup == 1) GLTF_CrossfadeToAnimationByIndex(&inst, 1, 0.f, 10.f, false);
+        if (setup == 2) {
+            for (int i = 0; i < ANIM_MAX_LAYERS - 1; ++i) GLTF_PushAnimLayer(&inst, 1, ABM_Override, -1, 1.f, 0.f, 10.f);
+        }
+        while (GLTF_GetAnimLayerCount(&inst) < ANIM_MAX_LAYERS - 1) GLTF_PushAnimLayer(&inst, 1, ABM_Override, mask, 1.f, 0.f, 0.f);
+        if (GLTF_GetAnimLayerCount(&inst) < ANIM_MAX_LAYERS) GLTF_PushAnimLayer(&inst, 0, ABM_Additive, -1, 0.5f, 0.f, 0.f);
+
+        const int pushed = GLTF_PushAnimLayer(&inst, 1, ABM_Override, mask, 1.f, 1.f, 0.f);
+        bool ok = GLTF_GetAnimLayerCount(&inst) == ANIM_MAX_LAYERS && GLTF_FindAnimLayer(&inst, 0, ABM_Override, -1) >= 0;
+        if (setup == 1) ok = ok && GLTF_FindAnimLayer(&inst, 1, ABM_Override, -1) >= 0;   // both sides of the fade
+        ok = ok && ((setup == 2) ? pushed < 0 : pushed >= 0);
+        if (!ok) ++failures;
+        std::printf("  full stack, %-22s push %s, base kept%s\n", evictNames[setup], pushed >= 0 ? "accepted" : "refused", ok ? "" : "  FAIL");
+        GLTF_DestroyAnimInstance(&inst, &engineMemArena);
+    }
+    gBoneMasks.pop_back();
+    return failures;
+}
+
+// ============================================================
+// Skin palettes: once per skin with the pose vs. the old rebuild per draw.
+void Bench_SkinPalettes() {
+    if (gSkins.empty() || gGLTFDraws.empty()) {
+        std::printf("[bench] palette: no skinned model loaded\n");
+        return;
+    }
+    AnimInstance inst;
+    if (!GLTF_CreateAnimInstance(&inst, &engineMemArena)) return;
+    std::vector<float> bones((size_t)gPaletteMatrices * 16 + 16);
+    int skinnedDraws = 0;
+    for (size_t di = 0; di < gGLTFDraws.size(); ++di) if (gGLTFDraws[di].skinned) ++skinnedDraws;
+    const int reps = 20000;
+
+    double t0 = Bench_NowMs();
+    for (int r = 0; r < reps; ++r) {
+        for (size_t di = 0; di < gGLTFDraws.size(); ++di) {
+            const GLTFDraw& d = gGLTFDraws[di];
+            if (!d.skinned || d.skinIndex < 0) continue;
+            const GLTFSkin& S = gSkins[(size_t)d.skinIndex];
+            for (int j = 0; j < d.boneCount; ++j) {
+                int slot = S.joints[(size_t)j];
+                Mat4 B = affineToMat4((slot >= 0) ? affineMul(inst.globals[(size_t)slot], S.invBind[(size_t)j]) : S.invBind[(size_t)j]);
+                std::memcpy(bones.data() + (size_t)j * 16, B.m, 16 * sizeof(float));
+            }
+        }
+    }
+    double t1 = Bench_NowMs();
+    for (int r = 0; r < reps; ++r) BuildSkinPalettes(&inst);
+    double t2 = Bench_NowMs();
+    gBenchSink = bones[0] + inst.palette[0];
+
+    std::printf("[bench] skin palettes, %zu skins, %d skinned draws, %d matrices, ns per instance\n", gSkins.size(), skinnedDraws, gPaletteMatrices);
+    std::printf("  per draw %8.0f  per skin %8.0f\n", (t1 - t0) * 1e6 / reps, (t2 - t1) * 1e6 / reps);
+    GLTF_DestroyAnimInstance(&inst, &engineMemArena);
+}
+
+// ============================================================
+// Skin palette uploads: the old fixed 8 KB glBufferSubData per draw vs.
+// deduplicated palettes written once per frame into the uniform ring, with
+// a bound range per draw.
+static void Bench_UploadSkinFixed(GLuint ubo, const float* bones, int boneCount) {
+    SkinUBO pack = {};
+    const int N = (boneCount > 128) ? 128 : boneCount;
+    if (bones && N > 0) std::memcpy(pack.uBones, bones, (size_t)N * 16 * sizeof(float));
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SkinUBO), &pack);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Bench_SkinUploads() {
+    if (gHierarchy.count == 0 || gAnims.empty() || !g_uniformRing.buffer) {
+        std::printf("[bench] upload: needs a model and the renderer's UBOs\n");
+        return;
+    }
+    static AnimInstance crowd[BENCH_CROWD];
+    int created = 0;
+    while (created < BENCH_CROWD && GLTF_CreateAnimInstance(&crowd[created], &engineMemArena)) ++created;
+    const int drawCount = (int)gGLTFDraws.size();
+    std::vector<UniformRange> ranges((size_t)created * drawCount);
+    GLuint fixedUbo = 0;
+    glGenBuffers(1, &fixedUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, fixedUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(SkinUBO), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    const int frames = 60;
+
+    std::printf("[bench] skin palette uploads, %d draws per instance, ms per frame (incl. glFinish)\n", drawCount);
+    std::printf("  %-10s %6s %10s %10s %10s %10s %8s\n", "crowd", "phase", "fixed ms", "fixed KB", "ranged ms", "ranged KB", "written");
+    const int sizes[] = { 1, 16, 256 };
+    for (int si = 0; si < 3; ++si) {
+        const int count = std::min(sizes[si], created);
+        for (int spread = 0; spread < 2; ++spread) {
+            for (int i = 0; i < count; ++i) {
+                GLTF_SetActiveAnimationByIndex(&crowd[i], 0, spread ? -0.037f * (float)i : 0.f);
+                frame_arena_reset(&frameScratchArena);
+                GLTF_UpdateAnimation_Pose(&crowd[i], 1.f, &frameScratchArena);
+            }
+            glFinish();
+            double t0 = Bench_NowMs();
+            for (int f = 0; f < frames; ++f) {
+                for (int i = 0; i < count; ++i)
+                    for (int di = 0; di < drawCount; ++di)
+                        Bench_UploadSkinFixed(fixedUbo, GLTF_GetDrawPalette(&crowd[i], gGLTFDraws[di]), gGLTFDraws[di].boneCount);
+                glFinish();
+            }
+            double t1 = Bench_NowMs();
+            GLStateInvalidate();   // the fixed path binds with raw gl calls
+            for (int f = 0; f < frames; ++f) {
+                BeginUniformFrame(0);
+                BeginSkinPalettes(count * drawCount);
+                for (int i = 0; i < count; ++i)
+                    for (int di = 0; di < drawCount; ++di)
+                        ranges[(size_t)i * drawCount + di] = PushSkinPalette(GLTF_GetDrawPalette(&crowd[i], gGLTFDraws[di]), gGLTFDraws[di].boneCount);
+                for (int k = 0; k < count * drawCount; ++k) BindSkinPalette(ranges[(size_t)k]);
+                EndUniformFrame();
+                glFinish();
+            }
+            double t2 = Bench_NowMs();
+            std::printf("  %-10d %6s %10.3f %10.1f %10.3f %10.1f %4d/%-4d\n", count, spread ? "spread" : "sync",
+                (t1 - t0) / frames, count * drawCount * sizeof(SkinUBO) / 1024.0, (t2 - t1) / frames, g_skinFrame.bytes / 1024.0,
+                g_skinFrame.uploads, g_skinFrame.requests);
+        }
+    }
+    glDeleteBuffers(1, &fixedUbo);
+    GLStateInvalidate();
+    for (int i = 0; i < created; ++i) GLTF_DestroyAnimInstance(&crowd[i], &engineMemArena);
+}
+
+// ============================================================
+// Per-draw uniforms: bind + glBufferSubData into one UBO before every draw
+// (the old path) vs. blocks written into the fenced uniform ring. Each draw
+// is a small quad tinted from its block. The check pass renders 16 ring
+// frames into separate tiles and reads them back once, so a block reused
+// before the GPU read it shows up as a wrong pixel.
+#define BENCH_RING_GRID 16     // draws per frame = grid * grid
+#define BENCH_RING_TILE 64     // pixels per frame tile, 4x4 tiles
+
+static const char* kBenchRingVS =
+    "#version 330 core\n"
+    "layout(std140) uniform PerDraw { mat4 uModel; vec4 uTint; };\n"
+    "out vec4 vTint;\n"
+    "void main() {\n"
+    "    gl_Position = uModel * vec4(float(gl_VertexID & 1), float(gl_VertexID >> 1), 0.0, 1.0);\n"
+    "    vTint = uTint;\n"
+    "}\n";
+static const char* kBenchRingFS =
+    "#version 330 core\n"
+    "in vec4 vTint;\n"
+    "out vec4 oColor;\n"
+    "void main() { oColor = vTint; }\n";
+
+// Draw d of a frame covers grid cell d; its tint encodes the cell and frame.
+static void Bench_RingDrawData(int d, int frame, float model[16], float tint[4]) {
+    const float cell = 2.f / BENCH_RING_GRID;
+    std::memset(model, 0, 16 * sizeof(float));
+    model[0] = cell; model[5] = cell; model[10] = 1.f; model[15] = 1.f;
+    model[12] = -1.f + cell * (float)(d % BENCH_RING_GRID);
+    model[13] = -1.f + cell * (float)(d / BENCH_RING_GRID);
+    tint[0] = (float)(d % BENCH_RING_GRID) / (BENCH_RING_GRID - 1);
+    tint[1] = (float)(d / BENCH_RING_GRID) / (BENCH_RING_GRID - 1);
+    tint[2] = (float)(frame % 16) / 15.f;
+    tint[3] = 1.f;
+}
+
+static void Bench_UpdatePerDrawFixed(GLuint ubo, const float model[16], const float tint[4]) {
+    PerDrawUBO data;
+    std::memcpy(data.uModel, model, sizeof(data.uModel));
+    std::memcpy(data.uTint, tint, sizeof(data.uTint));
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PerDrawUBO), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+int Bench_UniformRing() {
+    GLuint prog = CreateProgramFromSources(kBenchRingVS, kBenchRingFS);
+    if (!prog || !g_uniformRing.buffer) {
+        std::printf("[bench] ring: needs the renderer's uniform ring\n");
+        if (prog) glDeleteProgram(prog);
+        return 1;
+    }
+    glUniformBlockBinding(prog, glGetUniformBlockIndex(prog, "PerDraw"), 1);
+    RenderTarget rt = {};
+    CreateRenderTarget(rt, BENCH_RING_TILE * 4, BENCH_RING_TILE * 4);
+    GLuint vao = 0, fixedUbo = 0;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &fixedUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, fixedUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(PerDrawUBO), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    BeginRenderTarget(rt);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(prog);
+    glBindVertexArray(vao);
+    const int draws = BENCH_RING_GRID * BENCH_RING_GRID;
+    const int frames = 120;
+    float model[16], tint[4];
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, 1, fixedUbo);
+    glFinish();
+    double t0 = Bench_NowMs();
+    for (int f = 0; f < frames; ++f) {
+        for (int d = 0; d < draws; ++d) {
+            Bench_RingDrawData(d, f, model, tint);
+            Bench_UpdatePerDrawFixed(fixedUbo, model, tint);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        glFlush();
+    }
+    glFinish();
+    double t1 = Bench_NowMs();
+    GLStateInvalidate();   // the fixed path binds with raw gl calls
+    const int waits0 = g_uniformRing.fenceWaits;
+    for (int f = 0; f < frames; ++f) {
+        BeginUniformFrame(0);
+        for (int d = 0; d < draws; ++d) {
+            Bench_RingDrawData(d, f, model, tint);
+            UpdatePerDrawUBO(model, tint);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        EndUniformFrame();
+        glFlush();
+    }
+    glFinish();
+    double t2 = Bench_NowMs();
+
+    // Check pass: frame f lands in tile f, read back after all 16 are queued.
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    for (int f = 0; f < 16; ++f) {
+        glViewport((f % 4) * BENCH_RING_TILE, (f / 4) * BENCH_RING_TILE, BENCH_RING_TILE, BENCH_RING_TILE);
+        BeginUniformFrame(0);
+        for (int d = 0; d < draws; ++d) {
+            Bench_RingDrawData(d, f, model, tint);
+            UpdatePerDrawUBO(model, tint);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        EndUniformFrame();
+    }
+    std::vector<unsigned char> pixels((size_t)rt.w * rt.h * 4);
+    glReadPixels(0, 0, rt.w, rt.h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    const int cellPx = BENCH_RING_TILE / BENCH_RING_GRID;
+    int bad = 0;
+    for (int f = 0; f < 16; ++f) {
+        for (int d = 0; d < draws; ++d) {
+            Bench_RingDrawData(d, f, model, tint);
+            const int x = (f % 4) * BENCH_RING_TILE + (d % BENCH_RING_GRID) * cellPx + cellPx / 2;
+            const int y = (f / 4) * BENCH_RING_TILE + (d / BENCH_RING_GRID) * cellPx + cellPx / 2;
+            const unsigned char* px = &pixels[((size_t)y * rt.w + x) * 4];
+            for (int c = 0; c < 3; ++c) {
+                if (std::abs((int)px[c] - (int)(tint[c] * 255.f + 0.5f)) > 1) { ++bad; break; }
+            }
+        }
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glEnable(GL_DEPTH_TEST);
+    EndRenderTarget();
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &fixedUbo);
+    glDeleteProgram(prog);
+    DestroyRenderTarget(rt);
+    GLStateInvalidate();
+
+    std::printf("[bench] per-draw uniforms, %d draws x %d frames (%s ring)\n", draws, frames,
+        g_uniformRing.mapped ? "persistent mapped" : "glBufferSubData");
+    std::printf("  fixed UBO  %8.3f ms/frame\n", (t1 - t0) / frames);
+    std::printf("  ring       %8.3f ms/frame  (%d fence waits, %d growths)\n", (t2 - t1) / frames,
+        g_uniformRing.fenceWaits - waits0, g_uniformRing.growths);
+    std::printf("  check      %d/%d draws wrong%s\n", bad, 16 * draws, bad ? "  << FAIL" : "");
+    return bad ? 1 : 0;
+}
+
+// ============================================================
+// CPU skinning: throughput per kernel and per worker count, in vertices per
+// second over every skinned draw. Fails if a SIMD kernel disagrees with scalar.
+typedef void SkinKernel(const SkinnedVertex* verts, int count, const float* palette16, int boneCount, float* outXYZ);
+
+int Bench_CpuSkinning() {
+    if (gSkinnedVertices.empty() || gAnims.empty()) {
+        std::printf("[bench] skin: no skinned model loaded\n");
+        return 0;
+    }
+    AnimInstance inst;
+    if (!GLTF_CreateAnimInstance(&inst, &engineMemArena)) return 0;
+    GLTF_SetActiveAnimationByIndex(&inst, 0, 0.f);
+    frame_arena_reset(&frameScratchArena);
+    GLTF_UpdateAnimation_Pose(&inst, 1.f, &frameScratchArena);
+
+    std::vector<const GLTFDraw*> draws;
+    std::vector<std::vector<float> > palettes;
+    int totalVerts = 0;
+    for (size_t i = 0; i < gGLTFDraws.size(); ++i) {
+        const GLTFDraw& d = gGLTFDraws[i];
+        if (!d.skinned || d.boneCount <= 0) continue;
+        draws.push_back(&d);
+        palettes.push_back(std::vector<float>((size_t)d.boneCount * 16));
+        GLTF_GetBonesForDraw(&inst, d, palettes.back().data());
+        totalVerts += d.vertexCount;
+    }
+    GLTF_DestroyAnimInstance(&inst, &engineMemArena);
+    if (draws.empty()) {
+        std::printf("[bench] skin: no skinned draws\n");
+        return 0;
+    }
+
+    std::vector<float> ref((size_t)totalVerts * 3), out((size_t)totalVerts * 3);
+    const int reps = 100;
+    SkinKernel* kernels[3] = { skin_positions_scalar, NULL, NULL };
+    const char* kernelNames[3] = { "scalar", "sse", "avx2" };
+#if defined(MATH_SIMD_SSE)
+    kernels[1] = skin_positions_sse;
+#endif
+#if defined(MATH_SIMD_AVX2)
+    kernels[2] = skin_positions_avx2;
+#endif
+    int failures = 0;
+
+    std::printf("[bench] cpu skinning, %d vertices in %zu draws, up to 4 influences, %zu B/vertex\n", totalVerts, draws.size(), sizeof(SkinnedVertex));
+    std::printf("  %-12s %12s %10s\n", "kernel", "Mverts/s", "max diff");
+    for (int k = 0; k < 3; ++k) {
+        if (!kernels[k]) continue;
+        double t0 = Bench_NowMs();
+        for (int r = 0; r < reps; ++r) {
+            float* dst = (k == 0) ? ref.data() : out.data();
+            for (size_t di = 0; di < draws.size(); ++di) {
+                const GLTFDraw& d = *draws[di];
+                kernels[k](gSkinnedVertices.data() + d.vertexOffset, d.vertexCount, palettes[di].data(), d.boneCount, dst);
+                dst += (size_t)d.vertexCount * 3;
+            }
+        }
+        double ms = Bench_NowMs() - t0;
+        float maxDiff = 0.f;
+        if (k > 0) {
+            for (size_t i = 0; i < ref.size(); ++i) maxDiff = std::max(maxDiff, std::fabs(ref[i] - out[i]));
+        }
+        const bool ok = maxDiff <= 1e-4f;
+        if (!ok) ++failures;
+        std::printf("  %-12s %12.1f %10g%s\n", kernelNames[k], (double)totalVerts * reps / (ms * 1e3), maxDiff, ok ? "" : "  FAIL");
+    }
+    gBenchSink = out[0] + ref[0];
+
+    int maxWorkers = (int)std::thread::hardware_concurrency();
+    if (maxWorkers < 1) maxWorkers = 1;
+    if (maxWorkers > JOB_MAX_WORKERS) maxWorkers = JOB_MAX_WORKERS;
+    std::printf("  %-12s %12s %10s\n", "workers", "Mverts/s", "speedup");
+    job_system_shutdown(&gJobs);
+    double base = 0.0;
+    for (int w = 1; w <= maxWorkers; ++w) {
+        job_system_init(&gJobs, w, &engineMemArena);
+        double t0 = Bench_NowMs();
+        for (int r = 0; r < reps; ++r) {
+            float* dst = out.data();
+            for (size_t di = 0; di < draws.size(); ++di) {
+                const GLTFDraw& d = *draws[di];
+                skin_positions_parallel(&gJobs, gSkinnedVertices.data() + d.vertexOffset, d.vertexCount, palettes[di].data(), d.boneCount, dst);
+                dst += (size_t)d.vertexCount * 3;
+            }
+        }
+        double ms = Bench_NowMs() - t0;
+        job_system_shutdown(&gJobs);
+        double mvps = (double)totalVerts * reps / (ms * 1e3);
+        if (w == 1) base = mvps;
+        std::printf("  %-12d %12.1f %9.2fx\n", w, mvps, mvps / base);
+    }
+    job_system_init(&gJobs, 0, &engineMemArena);
+    return failures;
+}
+
+// ============================================================
+// Frustum culling: skinned bounds from per-joint boxes must contain every
+// CPU-skinned vertex for each clip at a spread of times (and how much looser
+// they are than the exact box), then the SIMD box test against scalar over
+// random boxes. Fails on an escaped vertex or a kernel mismatch.
+int Bench_Culling() {
+    int failures = 0;
+    size_t checked = 0, escaped = 0;
+    double looseness = 0.0;
+    int samples = 0;
+    AnimInstance inst;
+    if (!gAnims.empty() && GLTF_CreateAnimInstance(&inst, &engineMemArena)) {
+        std::vector<float> palette, xyz;
+        for (size_t a = 0; a < gAnims.size(); ++a) {
+            GLTF_SetActiveAnimationByIndex(&inst, (int)a, 0.f);
+            for (int s = 0; s < 16; ++s) {
+                frame_arena_reset(&frameScratchArena);
+                GLTF_UpdateAnimation_Pose(&inst, gAnims[a].durationSec * (float)s / 16.f, &frameScratchArena);
+                for (size_t di = 0; di < gGLTFDraws.size(); ++di) {
+                    const GLTFDraw& d = gGLTFDraws[di];
+                    if (!d.skinned || d.boneCount <= 0 || d.vertexCount <= 0) continue;
+                    palette.resize((size_t)d.boneCount * 16);
+                    xyz.resize((size_t)d.vertexCount * 3);
+                    GLTF_GetBonesForDraw(&inst, d, palette.data());
+                    skin_positions(gSkinnedVertices.data() + d.vertexOffset, d.vertexCount, palette.data(), d.boneCount, xyz.data());
+                    float lo[3], hi[3];
+                    if (!cull_skinned_aabb(d.jointBounds.data(), d.boneCount, palette.data(), lo, hi)) continue;
+                    float mn[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, mx[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+                    for (int v = 0; v < d.vertexCount; ++v) {
+                        bool inside = true;
+                        for (int k = 0; k < 3; ++k) {
+                            const float p = xyz[(size_t)v * 3 + k];
+                            const float eps = 1e-4f * (hi[k] - lo[k] + 1.f);
+                            inside = inside && p >= lo[k] - eps && p <= hi[k] + eps;
+                            mn[k] = std::min(mn[k], p);
+                            mx[k] = std::max(mx[k], p);
+                        }
+                        if (!inside) ++escaped;
+                    }
+                    checked += (size_t)d.vertexCount;
+                    double exact = 0.0, bound = 0.0;
+                    for (int k = 0; k < 3; ++k) {
+                        exact += (double)(mx[k] - mn[k]);
+                        bound += (double)(hi[k] - lo[k]);
+                    }
+                    if (exact > 0.0) { looseness += bound / exact; ++samples; }
+                }
+            }
+        }
+        GLTF_DestroyAnimInstance(&inst, &engineMemArena);
+    }
+    if (escaped > 0) ++failures;
+    std::printf("[bench] culling\n");
+    std::printf("  skinned bounds: %zu vertex checks over %zu clips x 16 poses, %zu outside%s, box edges %.2fx the exact box\n",
+        checked, gAnims.size(), escaped, escaped ? "  FAIL" : "", samples ? looseness / samples : 0.0);
+
+    // Boxes scattered around a 60-degree frustum so roughly half survive.
+    const int count = 1 << 16;
+    std::vector<float> data((size_t)count * 6);
+    std::vector<uint8_t> ref((size_t)count), out((size_t)count);
+    CullBoxes boxes = { &data[0], &data[(size_t)count], &data[(size_t)count * 2], &data[(size_t)count * 3], &data[(size_t)count * 4], &data[(size_t)count * 5] };
+    uint32_t seed = 12345u;
+    for (int i = 0; i < count; ++i) {
+        float r[6];
+        for (int k = 0; k < 6; ++k) {
+            seed = seed * 1664525u + 1013904223u;
+            r[k] = (float)(seed >> 8) / 16777216.f;
+        }
+        boxes.cx[i] = (r[0] - 0.5f) * 120.f; boxes.cy[i] = (r[1] - 0.5f) * 120.f; boxes.cz[i] = -r[2] * 100.f;
+        boxes.ex[i] = 0.1f + 2.f * r[3]; boxes.ey[i] = 0.1f + 2.f * r[4]; boxes.ez[i] = 0.1f + 2.f * r[5];
+    }
+    const Mat4 P = matPerspective(60.0f * 3.1415926f / 180.0f, 16.f / 9.f, 0.05f, 1000.0f);
+    CullFrustum frustum;
+    cull_extract_frustum(P.m, &frustum);
+
+    const int reps = 200;
+    int visibleRef = 0, visibleOut = 0;
+    double t0 = Bench_NowMs();
+    for (int r = 0; r < reps; ++r) visibleRef = cull_boxes_scalar(frustum, boxes, 0, count, ref.data());
+    const double scalarMs = Bench_NowMs() - t0;
+    t0 = Bench_NowMs();
+    for (int r = 0; r < reps; ++r) visibleOut = cull_boxes(frustum, boxes, count, out.data());
+    const double bestMs = Bench_NowMs() - t0;
+    const bool same = visibleRef == visibleOut && std::memcmp(ref.data(), out.data(), (size_t)count) == 0;
+    if (!same) ++failures;
+    gBenchSink = (float)(visibleRef + visibleOut);
+    std::printf("  %d boxes, %d visible: scalar %.2f ns/box, best %.2f ns/box%s\n", count, visibleRef,
+        scalarMs * 1e6 / ((double)count * reps), bestMs * 1e6 / ((double)count * reps), same ? "" : "  FAIL (mismatch)");
+    return failures;
+}
+
+// ============================================================
+// Draw list ordering: draw_list_sort against std::sort on (key, index),
+// which is the stable order, over keys shaped like a crowd frame (a few
+// pipelines and textures, many primitive/LOD pairs). Fails on any difference.
+int Bench_DrawList() {
+    const int count = 1 << 14;
+    std::vector<uint64_t> keys((size_t)count * 2), source((size_t)count);
+    std::vector<uint32_t> values((size_t)count * 2);
+    std::vector<std::pair<uint64_t, uint32_t> > ref((size_t)count);
+    uint32_t seed = 777u;
+    for (int i = 0; i < count; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        source[(size_t)i] = draw_list_key((seed >> 8) & 3u, 1u + ((seed >> 12) & 7u), (seed >> 16) & 255u);
+    }
+
+    const int reps = 50;
+    bool same = true;
+    double radixMs = 0.0, stdMs = 0.0;
+    for (int r = 0; r < reps; ++r) {
+        for (int i = 0; i < count; ++i) {
+            keys[(size_t)i] = source[(size_t)i];
+            values[(size_t)i] = (uint32_t)i;
+            ref[(size_t)i] = std::make_pair(source[(size_t)i], (uint32_t)i);
+        }
+        double t0 = Bench_NowMs();
+        draw_list_sort(&keys[0], &values[0], &keys[(size_t)count], &values[(size_t)count], count);
+        double t1 = Bench_NowMs();
+        std::sort(ref.begin(), ref.end());
+        double t2 = Bench_NowMs();
+        radixMs += t1 - t0;
+        stdMs += t2 - t1;
+        for (int i = 0; i < count && same; ++i) same = keys[(size_t)i] == ref[(size_t)i].first && values[(size_t)i] == ref[(size_t)i].second;
+    }
+    int batches = count > 0 ? 1 : 0;
+    for (int i = 1; i < count; ++i) batches += draw_list_same_batch(keys[(size_t)i - 1], keys[(size_t)i]) ? 0 : 1;
+    std::printf("[bench] draw list\n");
+    std::printf("  %d draws -> %d batches: radix %.2f ns/draw, std::sort %.2f ns/draw%s\n", count, batches,
+        radixMs * 1e6 / ((double)count * reps), stdMs * 1e6 / ((double)count * reps), same ? "" : "  FAIL (mismatch)");
+    return same ? 0 : 1;
+}
+
+// ============================================================
+// Crowd stress: 1,000 skinned instances, each on its own animation phase,
+// drawn offscreen at the coarsest LOD through both scene paths. Palettes is
+// the CPU time writing every palette, submit the time from there to the
+// last GL call, finish the glFinish after it. llvmpipe runs vertex shading
+// inside the draw calls, so there submit includes it. Fails when the
+// images differ.
+extern RenderState* renderState;
+extern Mat4 gModelPreXform;
+static void SubmitScenePerDraw(const Mat4& GlobalPre, int crowd, int members, const uint8_t* visible,
+    const UniformRange* paletteRanges, const int* lods);
+static bool SubmitSceneMultiDraw(const Mat4& PV, const Mat4& GlobalPre, int crowd, int members, const uint8_t* visible,
+    const UniformRange* paletteRanges, const float* const* palettes, const int* lods);
+
+int Bench_Crowd() {
+    const int count = 1000;
+    const int drawCount = (int)gGLTFDraws.size();
+    const int size = 512;
+    std::vector<AnimInstance> crowd((size_t)count);
+    int created = 0;
+    while (created < count && GLTF_CreateAnimInstance(&crowd[(size_t)created], &engineMemArena)) ++created;
+    std::printf("[bench] crowd, %d instances x %d draws, %dx%d offscreen\n", count, drawCount, size, size);
+    RenderTarget rt = {};
+    if (created < count || gAnims.empty() || drawCount == 0 || !CreateRenderTarget(rt, size, size)) {
+        std::printf("  FAIL (%d of %d instances created)\n", created, count);
+        for (int i = created - 1; i >= 0; --i) GLTF_DestroyAnimInstance(&crowd[(size_t)i], &engineMemArena);
+        return 1;
+    }
+    for (int i = 0; i < count; ++i) GLTF_SetActiveAnimationByIndex(&crowd[(size_t)i], i % (int)gAnims.size(), -0.037f * (float)i);
+    GLTF_UpdateAnimations(crowd.data(), count, 1.0f, &gJobs);
+
+    const size_t slots = (size_t)count * drawCount;
+    std::vector<UniformRange> paletteRanges(slots);
+    std::vector<const float*> palettes(slots);
+    std::vector<uint8_t> visible(slots, 1);
+    std::vector<int> lods((size_t)count, GLTF_MAX_LODS - 1);
+    for (size_t k = 0; k < slots; ++k) {
+        const GLTFDraw& d = gGLTFDraws[k % drawCount];
+        palettes[k] = (d.boneCount <= 128) ? GLTF_GetDrawPalette(&crowd[k / drawCount], d) : nullptr;
+    }
+    GLsizeiptr uniformBytes = 2 * UniformBlockBytes(sizeof(PerFrameUBO)) + UniformBlockBytes(64) +
+        UniformBlockBytes((GLsizeiptr)slots * sizeof(DrawRecord)) + UniformBlockBytes((GLsizeiptr)slots * sizeof(DrawElementsIndirectCommand));
+    for (int di = 0; di < drawCount; ++di)
+        uniformBytes += count * (UniformBlockBytes(sizeof(PerDrawUBO)) + UniformBlockBytes(gGLTFDraws[di].boneCount * 64));
+
+    // The grid is about 2 * sqrt(count) units across; look down on all of it.
+    const Mat4 P = matPerspective(60.0f * 3.1415926f / 180.0f, 1.0f, 0.5f, 500.0f);
+    const Mat4 V = matLookAt(0.f, 45.f, 60.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f);
+    const Mat4 PV = matMul(P, V);
+
+    const char* names[2] = { "per draw", "instanced" };
+    std::vector<unsigned char> pixels[2];
+    double paletteMs[2] = { 0.0, 0.0 }, submitMs[2] = { 0.0, 0.0 }, finishMs[2] = { 0.0, 0.0 };
+    int calls[2] = { 0, 0 };
+    bool ran[2] = { true, MultiDrawSupported() };
+    const int reps = 3;
+    for (int mode = 0; mode < 2; ++mode) {
+        for (int r = 0; r < (ran[mode] ? reps + 1 : 0); ++r) {   // rep 0 warms up
+            frame_arena_reset(&frameScratchArena);
+            BeginUniformFrame(uniformBytes);
+            UpdatePerFrameUBO(PV.m);
+            const double t0 = Bench_NowMs();
+            BeginSkinPalettes((int)slots);
+            for (size_t k = 0; k < slots; ++k) {
+                if (gGLTFDraws[k % drawCount].skinned) paletteRanges[k] = PushSkinPalette(palettes[k], gGLTFDraws[k % drawCount].boneCount);
+            }
+            const double tp = Bench_NowMs();
+            BeginRenderTarget(rt);
+            ClearFrame(0.f, 0.f, 0.f, 1.f);
+            renderState->gDrawCalls = 0;
+            if (mode == 0) SubmitScenePerDraw(gModelPreXform, count, count, visible.data(), paletteRanges.data(), lods.data());
+            else ran[mode] = SubmitSceneMultiDraw(PV, gModelPreXform, count, count, visible.data(), paletteRanges.data(), palettes.data(), lods.data());
+            const double t1 = Bench_NowMs();
+            glFinish();
+            const double t2 = Bench_NowMs();
+            if (r > 0) {
+                paletteMs[mode] += (tp - t0) / reps;
+                submitMs[mode] += (t1 - tp) / reps;
+                finishMs[mode] += (t2 - t1) / reps;
+            }
+            calls[mode] = renderState->gDrawCalls;
+            if (r == reps) {
+                pixels[mode].resize((size_t)size * size * 4);
+                glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels[mode].data());
+            }
+            EndRenderTarget();
+            EndUniformFrame();
+            if (!ran[mode]) break;
+        }
+        if (ran[mode]) std::printf("  %-10s %6d calls, palettes %7.3f ms, submit %8.3f ms, finish %8.2f ms\n", names[mode], calls[mode],
+            paletteMs[mode], submitMs[mode], finishMs[mode]);
+        else std::printf("  %-10s unavailable\n", names[mode]);
+    }
+    const bool same = !ran[1] || pixels[0] == pixels[1];
+    if (ran[1]) std::printf("  submit %.1fx faster, images %s\n", submitMs[0] / std::max(submitMs[1], 1e-3), same ? "match" : "differ  FAIL");
+
+    DestroyRenderTarget(rt);
+    for (int i = count - 1; i >= 0; --i) GLTF_DestroyAnimInstance(&crowd[(size_t)i], &engineMemArena);
+    return same ? 0 : 1;
+}
+
+// ============================================================
+// Program binary cache: both engine programs compiled from source against
+// the same programs loaded through CreateProgramCached once their entries
+// exist. Fails when the driver supports binaries but the second load
+// doesn't hit or the loaded program differs in active uniforms. Drivers
+// with their own shader cache make the source column optimistic.
+extern std::string gMeshShaderBase;
+extern std::string gPostShaderBase;
+std::string ReadTextFile(const std::string& path);
+
+int Bench_ProgramCache() {
+    const std::string bases[2] = { gMeshShaderBase, gPostShaderBase };
+    std::printf("[bench] program cache (%s), ms per program\n", ProgramCacheEnabled() ? "binaries supported" : "no binary support");
+    std::printf("  %-22s %10s %10s %10s %8s\n", "program", "source", "first", "cached", "speedup");
+    int failures = 0;
+    for (int i = 0; i < 2; ++i) {
+        const std::string vs = ReadTextFile(bases[i] + ".vert");
+        const std::string fs = ReadTextFile(bases[i] + ".frag");
+        if (vs.empty() || fs.empty()) {
+            std::printf("  %-22s missing sources\n", bases[i].c_str());
+            ++failures;
+            continue;
+        }
+        double t0 = Bench_NowMs();
+        GLuint src = CreateProgramFromSources(vs.c_str(), fs.c_str());
+        double t1 = Bench_NowMs();
+        GLuint first = CreateProgramCached(vs.c_str(), fs.c_str());   // may compile and save
+        double t2 = Bench_NowMs();
+        const int hits0 = g_programCache.hits;
+        GLuint cached = CreateProgramCached(vs.c_str(), fs.c_str());
+        double t3 = Bench_NowMs();
+
+        GLint uniformsSrc = -1, uniformsCached = -2;
+        if (src) glGetProgramiv(src, GL_ACTIVE_UNIFORMS, &uniformsSrc);
+        if (cached) glGetProgramiv(cached, GL_ACTIVE_UNIFORMS, &uniformsCached);
+        const bool hit = g_programCache.hits > hits0;
+        const bool ok = uniformsSrc == uniformsCached && (hit || !g_programCache.supported);
+        if (!ok) ++failures;
+        std::printf("  %-22s %10.2f %10.2f %10.2f %7.1fx%s\n", bases[i].c_str(), t1 - t0, t2 - t1, t3 - t2,
+            (t1 - t0) / std::max(t3 - t2, 1e-3), ok ? "" : "  FAIL");
+        if (src) glDeleteProgram(src);
+        if (first) glDeleteProgram(first);
+        if (cached) glDeleteProgram(cached);
+    }
+    std::printf("  cache: %d hits, %d misses, %d rejected, %d save failures\n", g_programCache.hits, g_programCache.misses,
+        g_programCache.rejected, g_programCache.saveFailures);
+    return failures;
+}
+
+// ============================================================
+int Bench_RunAll(const char* args) {
+    if (Bench_Wants(args, "keys")) Bench_KeyframeLookup();
+    if (Bench_Wants(args, "math")) Bench_MathKernels();
+    if (Bench_Wants(args, "jobs")) Bench_JobScaling();
+    if (Bench_Wants(args, "palette")) Bench_SkinPalettes();
+    if (Bench_Wants(args, "upload")) Bench_SkinUploads();
+    int failures = 0;
+    if (Bench_Wants(args, "clips")) failures += Bench_ClipCompression();
+    if (Bench_Wants(args, "layers")) failures += Bench_BlendLayers();
+    if (Bench_Wants(args, "skin")) failures += Bench_CpuSkinning();
+    if (Bench_Wants(args, "ring")) failures += Bench_UniformRing();
+    if (Bench_Wants(args, "cull")) failures += Bench_Culling();
+    if (Bench_Wants(args, "drawlist")) failures += Bench_DrawList();
+    if (Bench_Wants(args, "crowd")) failures += Bench_Crowd();
+    if (Bench_Wants(args, "shaders")) failures += Bench_ProgramCache();
+    std::fflush(stdout);
+    return failures > 0 ? 1 : 0;
+}
@@ -11,12 +11,14 @@ struct EngineData {
 
 struct RenderState {
 	RenderTarget gRT_Scene = {};
-	GLuint gProgramMesh = 0;
+	GLuint gProgramMesh[MESH_SHADER_PERMUTATIONS] = {};   // by MeshShaderKey, built on first use
 	GLuint gProgramPost = 0;
 
 	GLuint gVAO_Mesh = 0;
 	GLuint gVBO_Mesh = 0;
 	GLuint gEBO_Mesh = 0;
+	GLuint gVAO_MeshStatic = 0;   // unskinned primitives, shares gEBO_Mesh
+	GLuint gVBO_MeshStatic = 0;
 	GLuint gVAO_Post = 0;
 	GLuint gVBO_Post = 0;
 
@@ -25,4 +27,15 @@ struct RenderState {
 	float gYaw = 0.0f;
 	float gPitch = 0.0f;
 	bool  gWireframe = false;
+	int   gCrowdCount = 0;  // characters drawn, see SetCrowdCount
+	int   gDrawsVisible = 0;  // last frame's draws after frustum culling
+	int   gDrawsCulled = 0;
+	int   gDrawCalls = 0;     // last frame's scene draw calls, one per batch with multi-draw
+	bool  gMultiDraw = true;  // sorted multi-draw indirect submission when supported, 'M' toggles
+	bool  gDynamicResolution = true;
+	float gSceneScale = 1.0f;      // scene pass resolution / window, see UpdateSceneScale
+	float gFrameBudgetMs = 14.0f;  // GPU frame time the scale aims for, under a 60 Hz vsync interval
+
+	unsigned long long gFrameCount = 0;
+	unsigned long long gFrameHeapAllocs = 0;  // debug builds only, see debug_heap_alloc_count
 };
\ No newline at end of file
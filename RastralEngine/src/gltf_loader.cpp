@@ -8,26 +8,46 @@
 #include <unordered_map>
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include <vector>
 #include <string>
-#include <memory>
 
 #include "math_helper.h"
 #include "renderer.h"
 
 // ============================================================
 // Public draw record
-struct GLTFDraw {
+#define GLTF_MAX_LODS 4
+
+// One index range of a draw; every LOD indexes the same vertices.
+struct GLTFDrawLod {
     GLsizei indexCount = 0;
-    GLsizei indexOffset = 0;
+    size_t  indexByteOffset = 0;   // into the shared EBO
+    float   error = 0.f;           // simplification error relative to the primitive's extent
+};
+
+struct GLTFDraw {
+    GLTFDrawLod lods[GLTF_MAX_LODS];   // [0] is full detail
+    int     lodCount = 1;
+    GLenum  indexType = GL_UNSIGNED_INT;   // GL_UNSIGNED_SHORT when the range fits
+    int     vertexOffset = 0;   // range in gSkinnedVertices, or gStaticVertices if !skinned; also the base vertex
+    int     vertexCount = 0;
+
+    // Bounds of the vertex positions as stored (before skinning and uModel).
+    float   boundsMin[3] = { 0,0,0 };
+    float   boundsMax[3] = { 0,0,0 };
+    float   sphere[4] = { 0,0,0,0 };    // centre, radius
     GLuint  texture = 0;
     float   baseColor[4] = { 1,1,1,1 };
 
     bool    skinned = false;
+    int     maxInfluences = 0;   // most non-zero weights on any vertex, skinned only
+    int     shaderKey = 0;       // MeshShaderKey of the program variant it draws with
     int     boneCount = 0;
     std::vector<float> bones16; // 16 * boneCount
+    std::vector<float> jointBounds; // 6 * boneCount: min, max of the vertices each joint weights; min > max if none
 
     Mat4    localModel = matIdentity();
     int     skinIndex = -1;
@@ -35,64 +55,128 @@ struct GLTFDraw {
 
 // Exposed to the renderer
 std::vector<GLTFDraw> gGLTFDraws;
+std::vector<SkinnedVertex> gSkinnedVertices;   // CPU copies of the two VBOs
+std::vector<StaticVertex>  gStaticVertices;
 float gModelFitRadius = 1.0f;
 bool  gPlaceOnGround = true;
+bool  gOptimizeMeshOrder = true;   // vertex cache / overdraw / fetch order at import, see mesh_optimizer.cpp
+int   gMeshLodCount = GLTF_MAX_LODS;   // LODs built per primitive at import, 1 for none
+
+// Target index count (fraction of LOD 0) and error cap (fraction of the
+// primitive's extent) per LOD. A LOD that can't get 10% under the previous
+// one within its cap ends the chain.
+static const float kLodIndexRatio[GLTF_MAX_LODS] = { 1.f, 0.3f, 0.1f, 0.03f };
+static const float kLodMaxError[GLTF_MAX_LODS] = { 0.f, 0.01f, 0.03f, 0.1f };
 
 // ============================================================
 // Animation state
 enum AnimPath { AP_Translation, AP_Rotation, AP_Scale };
 
-struct AnimSampler {
-    int   inputAcc;    // times
-    int   outputAcc;   // values
-    int   comps;       // 3 or 4
-    std::string interp;
-    const tinygltf::Model* srcModel; // owning model for the accessors
-    AnimSampler() : inputAcc(-1), outputAcc(-1), comps(0), interp("LINEAR"), srcModel(NULL) {}
-};
-
+// One decoded track. Its times[keyCount] live in the owning clip's key
+// store at timesOfs. Values are floats[keyCount * comps] in the key store, or
+// for quantized tracks 3 x uint16 per key in the packed store, both at valuesOfs.
 struct AnimChannel {
-    int       sampler;
-    int       targetNode;
+    int       targetSlot;
     AnimPath  path;
-    AnimChannel() : sampler(-1), targetNode(-1), path(AP_Translation) {}
+    int       comps;       // 3 or 4
+    bool      step;
+    bool      quantized;   // see CompressAnimation
+    uint32_t  keyCount;
+    uint32_t  timesOfs;
+    uint32_t  valuesOfs;
+    float     qMin[3];     // T/S: value = qMin + q * qStep
+    float     qStep[3];
+    AnimChannel() : targetSlot(-1), path(AP_Translation), comps(0), step(false), quantized(false), keyCount(0), timesOfs(0), valuesOfs(0) {
+        qMin[0] = qMin[1] = qMin[2] = 0.f; qStep[0] = qStep[1] = qStep[2] = 0.f;
+    }
 };
 
 struct GLTFAnimation {
     std::string name;
-    std::vector<AnimSampler> samplers;
     std::vector<AnimChannel> channels;
+    std::vector<float> keys;      // contiguous per-clip store, decoded once at load
+    std::vector<uint16_t> packed; // quantized values of compressed tracks
+    std::vector<uint8_t> slotPaths;  // per hierarchy slot, bit (1 << AnimPath) per animated path
+    std::vector<float> additiveRef;  // per channel, 4 floats: value at the first key
     float durationSec;
     GLTFAnimation() : durationSec(0.f) {}
 };
 
 struct GLTFSkin {
-    std::vector<int>  joints;   // node indices
-    std::vector<Mat4> invBind;  // per-joint
+    std::vector<int>       joints;         // hierarchy slots (see FlatHierarchy)
+    std::vector<Affine3x4> invBind;        // per-joint
+    int                    paletteOffset;  // first matrix in AnimInstance::palette
+    GLTFSkin() : paletteOffset(0) {}
 };
 
 struct NodeTRS { float T[3]; float R[4]; float S[3]; };
 
+// Poses are SoA: stream s of slot i lives at pose[s * count + i].
+enum PoseStream { PS_TX, PS_TY, PS_TZ, PS_QX, PS_QY, PS_QZ, PS_QW, PS_SX, PS_SY, PS_SZ, POSE_STREAMS };
+
+// Default scene flattened at load in breadth-first order, so every parent
+// slot precedes its children and siblings are contiguous.
+struct FlatHierarchy {
+    int count;
+    std::vector<int>   node;    // slot -> glTF node
+    std::vector<int>   slotOf;  // glTF node -> slot, -1 if not in the scene
+    std::vector<int>   parent;  // slot -> parent slot, -1 for roots
+    std::vector<float> rest;    // rest pose, POSE_STREAMS * count
+    FlatHierarchy() : count(0) {}
+};
+
+// Shared asset: skeleton, skins, clips and mesh are immutable after load and
+// shared by every AnimInstance.
 std::vector<GLTFSkin>      gSkins;
-std::vector<NodeTRS>       gBaseTRS;
-std::vector<Mat4>          gGlobalsAnimated;
+FlatHierarchy              gHierarchy;
 std::vector<GLTFAnimation> gAnims;
+uint32_t                   gMaxClipChannels = 0;
+int                        gPaletteMatrices = 0;   // joints over all skins
+
+// Per-slot layer weights, e.g. 1 from the spine up and 0 below it.
+struct BoneMask {
+    std::string           name;
+    std::vector<float>    weight;  // per hierarchy slot, 0..1
+    std::vector<uint16_t> slots;   // slots with weight > 0, parent before child
+};
+std::vector<BoneMask> gBoneMasks;
 
 int   gIdleAnim = -1;
 float gIdleDuration = 0.f;
-int   gActiveAnim = -1;
-float gActiveDuration = 0.f;
-float gAnimT0 = 0.f;
-static int   gBlendFrom = -1;
-static int   gBlendTo = -1;
-static float gBlendStart = 0.f;
-static float gBlendDur = 0.f;
-static float gBlendFromT0 = 0.f;
-static float gBlendToT0 = 0.f;
-static bool  gBlendActive = false;
 
 tinygltf::Model gModelStatic;
-std::vector<std::unique_ptr<tinygltf::Model> > gAnimSources; // keep donors alive
+
+#define ANIM_MAX_LAYERS 4
+
+enum AnimBlendMode { ABM_Override, ABM_Additive };
+
+// One blend-tree layer. Override layers pull their masked slots toward the
+// clip's pose; additive layers add the clip's offset from its first frame.
+struct AnimLayer {
+    int           clip;
+    float         t0;          // clip clock origin
+    AnimBlendMode mode;
+    int           mask;        // gBoneMasks index, -1 for the whole body
+    float         weightFrom;  // weight ramps linearly over [fadeStart, fadeStart + fadeDur]
+    float         weightTo;
+    float         fadeStart;
+    float         fadeDur;
+    uint32_t*     cursors;     // gMaxClipChannels segment cursors
+    AnimLayer() : clip(-1), t0(0.f), mode(ABM_Override), mask(-1), weightFrom(0.f), weightTo(0.f), fadeStart(0.f), fadeDur(0.f), cursors(NULL) {}
+};
+
+// Per-character playback state: a stack of layers evaluated bottom to top.
+// The topmost whole-body override layer is the base clip; crossfades push a
+// new one above it. Globals and every layer's cursors come from one arena
+// allocation made by GLTF_CreateAnimInstance (see GLTF_AnimInstanceBytes).
+struct AnimInstance {
+    int        layerCount;
+    AnimLayer  layers[ANIM_MAX_LAYERS];  // all slots own cursors, in use or not
+    Affine3x4* globals;                  // pose output, per hierarchy slot
+    float*     palette;                  // skinning matrices (joint global * inverse bind) of every
+                                         // skin, column-major mat4 as the Skin UBO takes them
+    AnimInstance() : layerCount(0), globals(NULL), palette(NULL) {}
+};
 float gModelTarget[3] = { 0.f, 0.f, 0.f };
 
 // ============================================================
@@ -203,49 +287,101 @@ GLuint GetMaterialBaseColorTexture(std::vector<GLuint>& cache, const tinygltf::M
     GLuint tex = CreateTexture2D(img.width, img.height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, pixels, minF, magF, wrapS, wrapT);
     if (minF == GL_NEAREST_MIPMAP_NEAREST || minF == GL_NEAREST_MIPMAP_LINEAR ||
         minF == GL_LINEAR_MIPMAP_NEAREST || minF == GL_LINEAR_MIPMAP_LINEAR) {
-        glBindTexture(GL_TEXTURE_2D, tex);
+        BindTexture2D(0, tex);
         glGenerateMipmap(GL_TEXTURE_2D);
     }
     cache[texIdx] = tex;
     return tex;
 }
 
-Mat4 NodeLocalMatrix(const tinygltf::Node& n) {
+// Rest pose of a node. Matrix-only nodes are decomposed into TRS.
+NodeTRS NodeBaseTRS(const tinygltf::Node& n) {
+    NodeTRS b; b.T[0] = b.T[1] = b.T[2] = 0.f; b.R[0] = b.R[1] = b.R[2] = 0.f; b.R[3] = 1.f; b.S[0] = b.S[1] = b.S[2] = 1.f;
     if (n.matrix.size() == 16) {
-        Mat4 M; for (int i = 0; i < 16; ++i) M.m[i] = (float)n.matrix[i]; return M;
+        float m[16]; for (int i = 0; i < 16; ++i) m[i] = (float)n.matrix[i];
+        b.T[0] = m[12]; b.T[1] = m[13]; b.T[2] = m[14];
+        b.S[0] = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+        b.S[1] = std::sqrt(m[4] * m[4] + m[5] * m[5] + m[6] * m[6]);
+        b.S[2] = std::sqrt(m[8] * m[8] + m[9] * m[9] + m[10] * m[10]);
+        float cx, cy, cz; cross3(m[0], m[1], m[2], m[4], m[5], m[6], cx, cy, cz);
+        if (dot3(cx, cy, cz, m[8], m[9], m[10]) < 0.f) b.S[0] = -b.S[0];
+        for (int c = 0; c < 3; ++c) {
+            float inv = (std::fabs(b.S[c]) > 1e-8f) ? 1.f / b.S[c] : 0.f;
+            m[c * 4 + 0] *= inv; m[c * 4 + 1] *= inv; m[c * 4 + 2] *= inv;
+        }
+        float tr = m[0] + m[5] + m[10];
+        if (tr > 0.f) {
+            float k = 0.5f / std::sqrt(tr + 1.f);
+            b.R[3] = 0.25f / k; b.R[0] = (m[6] - m[9]) * k; b.R[1] = (m[8] - m[2]) * k; b.R[2] = (m[1] - m[4]) * k;
+        }
+        else if (m[0] > m[5] && m[0] > m[10]) {
+            float k = 2.f * std::sqrt(1.f + m[0] - m[5] - m[10]);
+            b.R[3] = (m[6] - m[9]) / k; b.R[0] = 0.25f * k; b.R[1] = (m[4] + m[1]) / k; b.R[2] = (m[8] + m[2]) / k;
+        }
+        else if (m[5] > m[10]) {
+            float k = 2.f * std::sqrt(1.f + m[5] - m[0] - m[10]);
+            b.R[3] = (m[8] - m[2]) / k; b.R[0] = (m[4] + m[1]) / k; b.R[1] = 0.25f * k; b.R[2] = (m[9] + m[6]) / k;
+        }
+        else {
+            float k = 2.f * std::sqrt(1.f + m[10] - m[0] - m[5]);
+            b.R[3] = (m[1] - m[4]) / k; b.R[0] = (m[8] + m[2]) / k; b.R[1] = (m[9] + m[6]) / k; b.R[2] = 0.25f * k;
+        }
+        return b;
     }
-    float tx = 0, ty = 0, tz = 0;
-    float qx = 0, qy = 0, qz = 0, qw = 1;
-    float sx = 1, sy = 1, sz = 1;
-    if (n.translation.size() == 3) { tx = (float)n.translation[0]; ty = (float)n.translation[1]; tz = (float)n.translation[2]; }
-    if (n.rotation.size() == 4) { qx = (float)n.rotation[0];    qy = (float)n.rotation[1];    qz = (float)n.rotation[2];    qw = (float)n.rotation[3]; }
-    if (n.scale.size() == 3) { sx = (float)n.scale[0];       sy = (float)n.scale[1];       sz = (float)n.scale[2]; }
-    return matMul(Mat4Translate(tx, ty, tz), matMul(matFromQuat(qx, qy, qz, qw), matScale(sx, sy, sz)));
+    if (n.translation.size() == 3) { b.T[0] = (float)n.translation[0]; b.T[1] = (float)n.translation[1]; b.T[2] = (float)n.translation[2]; }
+    if (n.rotation.size() == 4) { b.R[0] = (float)n.rotation[0];    b.R[1] = (float)n.rotation[1];    b.R[2] = (float)n.rotation[2];    b.R[3] = (float)n.rotation[3]; }
+    if (n.scale.size() == 3) { b.S[0] = (float)n.scale[0];       b.S[1] = (float)n.scale[1];       b.S[2] = (float)n.scale[2]; }
+    return b;
 }
 
-void ComputeGlobalTransforms(const tinygltf::Model& model, std::vector<Mat4>& globals) {
-    globals.assign(model.nodes.size(), matIdentity());
+void BuildFlatHierarchy(const tinygltf::Model& model, FlatHierarchy& H) {
+    H.node.clear(); H.parent.clear();
+    H.slotOf.assign(model.nodes.size(), -1);
     int sceneIndex = model.defaultScene >= 0 ? model.defaultScene : (model.scenes.empty() ? -1 : 0);
-    if (sceneIndex < 0) return;
-
-    struct Item { int node; Mat4 parent; };
-    std::vector<Item> st;
-    for (size_t i = 0; i < model.scenes[sceneIndex].nodes.size(); ++i) {
-        int root = model.scenes[sceneIndex].nodes[i];
-        Item it; it.node = root; it.parent = matIdentity();
-        st.push_back(it);
-    }
-
-    while (!st.empty()) {
-        Item it = st.back(); st.pop_back();
-        const tinygltf::Node& n = model.nodes[it.node];
-        Mat4 G = matMul(it.parent, NodeLocalMatrix(n));
-        globals[it.node] = G;
-        for (size_t c = 0; c < n.children.size(); ++c) {
-            Item child; child.node = n.children[c]; child.parent = G;
-            st.push_back(child);
+    if (sceneIndex >= 0) {
+        const std::vector<int>& roots = model.scenes[(size_t)sceneIndex].nodes;
+        for (size_t i = 0; i < roots.size(); ++i) {
+            int n = roots[i];
+            if (n < 0 || n >= (int)model.nodes.size() || H.slotOf[(size_t)n] >= 0) continue;
+            H.slotOf[(size_t)n] = (int)H.node.size();
+            H.node.push_back(n); H.parent.push_back(-1);
+        }
+        for (size_t head = 0; head < H.node.size(); ++head) {
+            const tinygltf::Node& n = model.nodes[(size_t)H.node[head]];
+            for (size_t c = 0; c < n.children.size(); ++c) {
+                int ch = n.children[c];
+                if (ch < 0 || ch >= (int)model.nodes.size() || H.slotOf[(size_t)ch] >= 0) continue;
+                H.slotOf[(size_t)ch] = (int)H.node.size();
+                H.node.push_back(ch); H.parent.push_back((int)head);
+            }
         }
     }
+
+    H.count = (int)H.node.size();
+    const size_t N = (size_t)H.count;
+    H.rest.resize(N * POSE_STREAMS);
+    for (size_t i = 0; i < N; ++i) {
+        NodeTRS b = NodeBaseTRS(model.nodes[(size_t)H.node[i]]);
+        H.rest[PS_TX * N + i] = b.T[0]; H.rest[PS_TY * N + i] = b.T[1]; H.rest[PS_TZ * N + i] = b.T[2];
+        H.rest[PS_QX * N + i] = b.R[0]; H.rest[PS_QY * N + i] = b.R[1]; H.rest[PS_QZ * N + i] = b.R[2]; H.rest[PS_QW * N + i] = b.R[3];
+        H.rest[PS_SX * N + i] = b.S[0]; H.rest[PS_SY * N + i] = b.S[1]; H.rest[PS_SZ * N + i] = b.S[2];
+    }
+}
+
+// Locals are independent per slot; the parent pass is one forward loop
+// because parent slots always come first.
+void ComputeGlobalTransforms(const FlatHierarchy& H, const float* pose, Affine3x4* globals) {
+    const size_t N = (size_t)H.count;
+    const float* tx = pose + PS_TX * N; const float* ty = pose + PS_TY * N; const float* tz = pose + PS_TZ * N;
+    const float* qx = pose + PS_QX * N; const float* qy = pose + PS_QY * N; const float* qz = pose + PS_QZ * N; const float* qw = pose + PS_QW * N;
+    const float* sx = pose + PS_SX * N; const float* sy = pose + PS_SY * N; const float* sz = pose + PS_SZ * N;
+    for (size_t i = 0; i < N; ++i) {
+        globals[i] = affineTRS(tx[i], ty[i], tz[i], qx[i], qy[i], qz[i], qw[i], sx[i], sy[i], sz[i]);
+    }
+    const int* parent = H.parent.data();
+    for (size_t i = 0; i < N; ++i) {
+        if (parent[i] >= 0) globals[i] = affineMul(globals[(size_t)parent[i]], globals[i]);
+    }
 }
 
 bool getAsFloat(const tinygltf::Model& model, int accessorIndex, std::vector<float>& out, int& comps) {
@@ -285,11 +421,399 @@ bool getAsFloat(const tinygltf::Model& model, int accessorIndex, std::vector<flo
     return true;
 }
 
+AnimPath AnimPathFromString(const std::string& path) {
+    if (path == "translation") return AP_Translation;
+    if (path == "rotation") return AP_Rotation;
+    return AP_Scale;
+}
+
+// Decodes the sampler's accessors into A.keys and fills C's offsets.
+// CUBICSPLINE keys are reduced to their value element (tangents dropped).
+bool DecodeAnimChannel(const tinygltf::Model& src, const tinygltf::AnimationSampler& s, GLTFAnimation& A, AnimChannel& C) {
+    std::vector<float> times; int tComps = 0;
+    std::vector<float> vals;  int vComps = 0;
+    if (!getAsFloat(src, s.input, times, tComps) || tComps != 1 || times.empty()) return false;
+    if (!getAsFloat(src, s.output, vals, vComps)) return false;
+
+    const int want = (C.path == AP_Rotation) ? 4 : 3;
+    if (vComps != want) return false;
+
+    const bool cubic = (s.interpolation == "CUBICSPLINE");
+    const size_t keyCount = times.size();
+    const size_t stride = cubic ? 3 : 1;
+    if (vals.size() < keyCount * stride * (size_t)vComps) return false;
+
+    C.comps = vComps;
+    C.step = (s.interpolation == "STEP");
+    C.keyCount = (uint32_t)keyCount;
+    C.timesOfs = (uint32_t)A.keys.size();
+    A.keys.insert(A.keys.end(), times.begin(), times.end());
+    C.valuesOfs = (uint32_t)A.keys.size();
+    for (size_t k = 0; k < keyCount; ++k) {
+        const float* v = &vals[(k * stride + (cubic ? 1 : 0)) * (size_t)vComps];
+        A.keys.insert(A.keys.end(), v, v + vComps);
+    }
+    return true;
+}
+
+// nodeMap[srcNode] gives the gHierarchy slot a channel drives, or -1 to drop it.
+void DecodeAnimation(const tinygltf::Model& src, const tinygltf::Animation& a, const std::vector<int>& nodeMap, GLTFAnimation& A) {
+    A.name = a.name;
+    for (size_t si = 0; si < a.samplers.size(); ++si) {
+        float mt = AccessorMaxTime(src, a.samplers[si].input);
+        if (mt > A.durationSec) A.durationSec = mt;
+    }
+    for (size_t ci = 0; ci < a.channels.size(); ++ci) {
+        const tinygltf::AnimationChannel& c = a.channels[ci];
+        if (c.sampler < 0 || c.sampler >= (int)a.samplers.size()) continue;
+        if (c.target_node < 0 || c.target_node >= (int)nodeMap.size()) continue;
+        if (c.target_path != "translation" && c.target_path != "rotation" && c.target_path != "scale") continue;
+
+        AnimChannel C;
+        C.targetSlot = nodeMap[(size_t)c.target_node];
+        if (C.targetSlot < 0) continue;
+        C.path = AnimPathFromString(c.target_path);
+        if (!DecodeAnimChannel(src, a.samplers[(size_t)c.sampler], A, C)) continue;
+        A.channels.push_back(C);
+    }
+}
+
+// ============================================================
+// Clip compression (import time)
+// Rotations are packed smallest-three into 48 bits; translations and scales
+// are quantized to 16 bits per component against the track's own range.
+// Before packing, keys that interpolating their neighbours reproduces within
+// the error bounds are dropped, and tracks that never leave the rest pose go
+// away entirely. Quantization adds at most half a step on top of the bounds.
+struct AnimCompressionSettings {
+    bool  enabled;
+    float maxPositionError;  // translation, model units
+    float maxAngleError;     // rotation, radians
+    float maxScaleError;     // scale, absolute per component
+};
+
+AnimCompressionSettings gAnimCompression = { true, 0.01f, 0.001f, 0.0001f };
+
+void normalizeQ(float q[4]);
+static void slerpQ(const float a[4], const float bIn[4], float u, float out[4]);
+
+#define QUAT48_RANGE 0.70710678f   // the three smallest components lie in +-1/sqrt(2)
+#define QUAT48_MAX 32767.f
+
+// 2-bit index of the dropped largest component, then 3 x 15 bits.
+void PackQuat48(const float qIn[4], uint16_t out[3]) {
+    float q[4] = { qIn[0], qIn[1], qIn[2], qIn[3] };
+    normalizeQ(q);
+    int big = 0;
+    for (int c = 1; c < 4; ++c) if (std::fabs(q[c]) > std::fabs(q[big])) big = c;
+    const float sign = q[big] < 0.f ? -1.f : 1.f;
+    uint64_t bits = (uint64_t)big;
+    int shift = 2;
+    for (int c = 0; c < 4; ++c) {
+        if (c == big) continue;
+        float v = q[c] * sign / QUAT48_RANGE;
+        v = std::min(1.f, std::max(-1.f, v));
+        bits |= (uint64_t)(uint32_t)std::lround((v * 0.5f + 0.5f) * QUAT48_MAX) << shift;
+        shift += 15;
+    }
+    out[0] = (uint16_t)bits; out[1] = (uint16_t)(bits >> 16); out[2] = (uint16_t)(bits >> 32);
+}
+
+void UnpackQuat48(const uint16_t in[3], float q[4]) {
+    const uint64_t bits = (uint64_t)in[0] | ((uint64_t)in[1] << 16) | ((uint64_t)in[2] << 32);
+    const int big = (int)(bits & 3u);
+    int shift = 2;
+    float sum = 0.f;
+    for (int c = 0; c < 4; ++c) {
+        if (c == big) continue;
+        float v = ((float)((bits >> shift) & 0x7FFFu) / QUAT48_MAX * 2.f - 1.f) * QUAT48_RANGE;
+        q[c] = v; sum += v * v;
+        shift += 15;
+    }
+    q[big] = std::sqrt(std::max(0.f, 1.f - sum));
+}
+
+// Rotation angle between unit quaternions. The chord form stays accurate for
+// tiny angles, where 2*acos(dot) collapses to a few representable values.
+static float QuatAngle(const float a[4], const float b[4]) {
+    const float s = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]) < 0.f ? -1.f : 1.f;
+    float d2 = 0.f;
+    for (int c = 0; c < 4; ++c) { float d = a[c] - s * b[c]; d2 += d * d; }
+    return 4.f * std::asin(std::min(1.f, 0.5f * std::sqrt(d2)));
+}
+
+// Distance between two values of a track, in the units of its error bound.
+static float AnimValueError(AnimPath path, const float* a, const float* b) {
+    if (path == AP_Rotation) {
+        float qa[4] = { a[0], a[1], a[2], a[3] }, qb[4] = { b[0], b[1], b[2], b[3] };
+        normalizeQ(qa); normalizeQ(qb);
+        return QuatAngle(qa, qb);
+    }
+    if (path == AP_Translation) {
+        float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    return std::max(std::fabs(a[0] - b[0]), std::max(std::fabs(a[1] - b[1]), std::fabs(a[2] - b[2])));
+}
+
+// Value of key k when reconstructed from keys a and b the way the sampler would.
+static void AnimInterpolateKey(const AnimChannel& C, const float* times, const float* vals, uint32_t a, uint32_t b, uint32_t k, float out[4]) {
+    const int n = C.comps;
+    const float u = C.step ? 0.f : (times[k] - times[a]) / std::max(1e-6f, times[b] - times[a]);
+    if (C.path == AP_Rotation) {
+        float q0[4] = { vals[a * 4 + 0], vals[a * 4 + 1], vals[a * 4 + 2], vals[a * 4 + 3] };
+        float q1[4] = { vals[b * 4 + 0], vals[b * 4 + 1], vals[b * 4 + 2], vals[b * 4 + 3] };
+        normalizeQ(q0); normalizeQ(q1);
+        slerpQ(q0, q1, u, out);
+        return;
+    }
+    for (int c = 0; c < n; ++c) out[c] = vals[a * n + c] * (1.f - u) + vals[b * n + c] * u;
+}
+
+float AnimErrorBound(AnimPath path, const AnimCompressionSettings& s) {
+    if (path == AP_Rotation) return s.maxAngleError;
+    if (path == AP_Translation) return s.maxPositionError;
+    return s.maxScaleError;
+}
+
+// Greedy pass: each segment grows while every key it skips stays in bounds.
+static void ReduceKeys(const AnimChannel& C, const float* times, const float* vals, float bound, std::vector<uint32_t>& kept) {
+    kept.clear();
+    kept.push_back(0);
+    if (C.keyCount < 2) return;
+    uint32_t a = 0;
+    float v[4];
+    for (uint32_t b = 2; b < C.keyCount; ++b) {
+        bool ok = true;
+        for (uint32_t k = a + 1; k < b && ok; ++k) {
+            AnimInterpolateKey(C, times, vals, a, b, k, v);
+            ok = AnimValueError(C.path, v, vals + (size_t)k * C.comps) <= bound;
+        }
+        if (!ok) { kept.push_back(b - 1); a = b - 1; }
+    }
+    // A flat track keeps a single key.
+    bool flat = (kept.size() == 1);
+    for (uint32_t k = 1; k < C.keyCount && flat; ++k) flat = AnimValueError(C.path, vals, vals + (size_t)k * C.comps) <= bound;
+    if (!flat) kept.push_back(C.keyCount - 1);
+}
+
+void CompressAnimation(const GLTFAnimation& src, const FlatHierarchy& H, const AnimCompressionSettings& s, GLTFAnimation& dst) {
+    dst.name = src.name;
+    dst.durationSec = src.durationSec;
+    dst.channels.clear(); dst.keys.clear(); dst.packed.clear();
+
+    const size_t N = (size_t)H.count;
+    std::vector<uint32_t> kept;
+    for (size_t ch = 0; ch < src.channels.size(); ++ch) {
+        const AnimChannel& C = src.channels[ch];
+        if (C.quantized || C.keyCount == 0) continue;
+        const float* times = src.keys.data() + C.timesOfs;
+        const float* vals = src.keys.data() + C.valuesOfs;
+        const float bound = AnimErrorBound(C.path, s);
+        ReduceKeys(C, times, vals, bound, kept);
+
+        if (kept.size() == 1) {
+            const size_t i = (size_t)C.targetSlot;
+            float rest[4];
+            if (C.path == AP_Translation) { rest[0] = H.rest[PS_TX * N + i]; rest[1] = H.rest[PS_TY * N + i]; rest[2] = H.rest[PS_TZ * N + i]; }
+            else if (C.path == AP_Scale) { rest[0] = H.rest[PS_SX * N + i]; rest[1] = H.rest[PS_SY * N + i]; rest[2] = H.rest[PS_SZ * N + i]; }
+            else { rest[0] = H.rest[PS_QX * N + i]; rest[1] = H.rest[PS_QY * N + i]; rest[2] = H.rest[PS_QZ * N + i]; rest[3] = H.rest[PS_QW * N + i]; }
+            // Every key within bound of rest: the pose starts from rest anyway.
+            bool atRest = true;
+            for (uint32_t k = 0; k < C.keyCount && atRest; ++k) atRest = AnimValueError(C.path, vals + (size_t)k * C.comps, rest) <= bound;
+            if (atRest) continue;
+        }
+
+        AnimChannel D = C;
+        D.quantized = true;
+        D.keyCount = (uint32_t)kept.size();
+        D.timesOfs = (uint32_t)dst.keys.size();
+        for (size_t k = 0; k < kept.size(); ++k) dst.keys.push_back(times[kept[k]]);
+        D.valuesOfs = (uint32_t)dst.packed.size();
+        dst.packed.resize(dst.packed.size() + kept.size() * 3);
+        uint16_t* out = dst.packed.data() + D.valuesOfs;
+
+        if (C.path == AP_Rotation) {
+            for (size_t k = 0; k < kept.size(); ++k) PackQuat48(vals + (size_t)kept[k] * 4, out + k * 3);
+        }
+        else {
+            for (int c = 0; c < 3; ++c) {
+                float lo = FLT_MAX, hi = -FLT_MAX;
+                for (size_t k = 0; k < kept.size(); ++k) { float v = vals[(size_t)kept[k] * 3 + c]; lo = std::min(lo, v); hi = std::max(hi, v); }
+                D.qMin[c] = lo;
+                D.qStep[c] = (hi - lo) / 65535.f;
+                for (size_t k = 0; k < kept.size(); ++k) {
+                    float q = (D.qStep[c] > 0.f) ? (vals[(size_t)kept[k] * 3 + c] - lo) / D.qStep[c] : 0.f;
+                    out[k * 3 + c] = (uint16_t)std::min(65535L, std::max(0L, std::lround(q)));
+                }
+            }
+        }
+        dst.channels.push_back(D);
+    }
+}
+
+size_t GLTF_AnimationBytes(const GLTFAnimation& A) {
+    return A.channels.size() * sizeof(AnimChannel) + A.keys.size() * sizeof(float) + A.packed.size() * sizeof(uint16_t);
+}
+
+static void SampleChannel(const GLTFAnimation& A, const AnimChannel& C, float t, uint32_t& cursor, float v[4]);
+
+// Tables the layer evaluator needs: which paths each slot animates, and the
+// first-frame reference additive layers are measured against.
+static void BuildLayerTables(GLTFAnimation& A) {
+    A.slotPaths.assign((size_t)gHierarchy.count, 0);
+    A.additiveRef.assign(A.channels.size() * 4, 0.f);
+    for (size_t ch = 0; ch < A.channels.size(); ++ch) {
+        const AnimChannel& C = A.channels[ch];
+        A.slotPaths[(size_t)C.targetSlot] |= (uint8_t)(1 << C.path);
+        uint32_t cursor = 0;
+        SampleChannel(A, C, -1.f, cursor, &A.additiveRef[ch * 4]);
+    }
+}
+
+// Compresses a freshly decoded clip when enabled and adds it to gAnims.
+int AddAnimation(const GLTFAnimation& raw) {
+    if (gAnimCompression.enabled) {
+        GLTFAnimation A;
+        CompressAnimation(raw, gHierarchy, gAnimCompression, A);
+        std::fprintf(stderr, "[anim] '%s' compressed %zu -> %zu bytes, %zu -> %zu tracks\n",
+            raw.name.c_str(), GLTF_AnimationBytes(raw), GLTF_AnimationBytes(A), raw.channels.size(), A.channels.size());
+        gAnims.push_back(A);
+    }
+    else {
+        gAnims.push_back(raw);
+    }
+    BuildLayerTables(gAnims.back());
+    gMaxClipChannels = std::max(gMaxClipChannels, (uint32_t)gAnims.back().channels.size());
+    return (int)gAnims.size() - 1;
+}
+
 // ============================================================
 // Mesh + textures
+
+// Round-to-nearest-even float to IEEE half.
+static uint16_t FloatToHalf(float f) {
+    uint32_t x; std::memcpy(&x, &f, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    x &= 0x7FFFFFFFu;
+    if (x >= 0x7F800000u) return (uint16_t)(sign | 0x7C00u | ((x > 0x7F800000u) ? 0x200u : 0u));   // inf, nan
+    if (x >= 0x477FF000u) return (uint16_t)(sign | 0x7C00u);     // rounds past 65504
+    if (x < 0x38800000u) {                                        // half subnormal
+        if (x < 0x33000000u) return (uint16_t)sign;
+        const uint32_t shift = 126u - (x >> 23);
+        const uint32_t m = (x & 0x7FFFFFu) | 0x800000u;
+        uint32_t h = m >> shift;
+        const uint32_t rem = m & ((1u << shift) - 1u), half = 1u << (shift - 1u);
+        if (rem > half || (rem == half && (h & 1u))) ++h;
+        return (uint16_t)(sign | h);
+    }
+    uint32_t h = (x - 0x38000000u) >> 13;
+    const uint32_t rem = x & 0x1FFFu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) ++h;
+    return (uint16_t)(sign | h);
+}
+
+// Normalized weights to unorm8 summing to exactly 255: floor each, then hand
+// the leftover units to the largest remainders.
+static void QuantizeWeights(const float w[4], uint8_t out[4]) {
+    int q[4]; float frac[4]; int sum = 0;
+    for (int c = 0; c < 4; ++c) {
+        const float v = w[c] * 255.f;
+        q[c] = (int)v;
+        frac[c] = v - (float)q[c];
+        sum += q[c];
+    }
+    while (sum < 255) {
+        int best = 0;
+        for (int c = 1; c < 4; ++c) if (frac[c] > frac[best]) best = c;
+        ++q[best]; frac[best] -= 1.f; ++sum;
+    }
+    for (int c = 0; c < 4; ++c) out[c] = (uint8_t)q[c];
+}
+
+// Heaviest influence first, so shader variants with fewer than four
+// influences read exactly the non-zero ones. Returns how many there are.
+static int SortInfluences(uint8_t joints[4], uint8_t weights[4]) {
+    for (int a = 1; a < 4; ++a) {
+        for (int b = a; b > 0 && weights[b] > weights[b - 1]; --b) {
+            std::swap(weights[b], weights[b - 1]);
+            std::swap(joints[b], joints[b - 1]);
+        }
+    }
+    int n = 0;
+    while (n < 4 && weights[n] != 0) ++n;
+    return n;
+}
+
+// AABB and sphere over a draw's vertex range; pos is the first member of both vertex layouts.
+static void ComputeDrawBounds(GLTFDraw& d, const void* verts, size_t stride, int count) {
+    const uint8_t* base = (const uint8_t*)verts;
+    float mn[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, mx[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (int i = 0; i < count; ++i) {
+        const float* p = (const float*)(base + (size_t)i * stride);
+        for (int k = 0; k < 3; ++k) { mn[k] = std::min(mn[k], p[k]); mx[k] = std::max(mx[k], p[k]); }
+    }
+    if (count <= 0) return;
+    float r2 = 0.f;
+    for (int k = 0; k < 3; ++k) {
+        d.boundsMin[k] = mn[k];
+        d.boundsMax[k] = mx[k];
+        d.sphere[k] = 0.5f * (mn[k] + mx[k]);
+    }
+    for (int i = 0; i < count; ++i) {
+        const float* p = (const float*)(base + (size_t)i * stride);
+        const float dx = p[0] - d.sphere[0], dy = p[1] - d.sphere[1], dz = p[2] - d.sphere[2];
+        r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+    }
+    d.sphere[3] = std::sqrt(r2);
+}
+
+// Per-joint boxes over the vertices each joint has weight on, for bounds that
+// follow the pose (cull_skinned_aabb).
+static void ComputeJointBounds(GLTFDraw& d, const SkinnedVertex* verts, int count) {
+    d.jointBounds.resize((size_t)d.boneCount * 6);
+    for (int j = 0; j < d.boneCount; ++j) {
+        float* b = &d.jointBounds[(size_t)j * 6];
+        b[0] = b[1] = b[2] = FLT_MAX;
+        b[3] = b[4] = b[5] = -FLT_MAX;
+    }
+    for (int i = 0; i < count; ++i) {
+        const SkinnedVertex& v = verts[i];
+        for (int c = 0; c < 4; ++c) {
+            if (v.weights[c] == 0 || v.joints[c] >= d.boneCount) continue;
+            float* b = &d.jointBounds[(size_t)v.joints[c] * 6];
+            for (int k = 0; k < 3; ++k) {
+                b[k] = std::min(b[k], v.pos[k]);
+                b[3 + k] = std::max(b[3 + k], v.pos[k]);
+            }
+        }
+    }
+}
+
+// Appends one draw's indices to the shared EBO image as 16- or 32-bit and
+// returns the byte offset; each range is aligned to its index size.
+static size_t AppendIndexRange(std::vector<uint8_t>& bytes, const std::vector<uint32_t>& idx, GLenum type) {
+    const size_t elem = (type == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+    const size_t offset = (bytes.size() + elem - 1) & ~(elem - 1);
+    bytes.resize(offset + idx.size() * elem);
+    if (type == GL_UNSIGNED_SHORT) {
+        uint16_t* dst = (uint16_t*)(bytes.data() + offset);
+        for (size_t i = 0; i < idx.size(); ++i) dst[i] = (uint16_t)idx[i];
+    }
+    else if (!idx.empty()) {
+        std::memcpy(bytes.data() + offset, idx.data(), idx.size() * sizeof(uint32_t));
+    }
+    return offset;
+}
+
+// Skinned primitives go to one vertex stream (outVAO/outVBO, SkinnedVertex),
+// static ones with positions baked to model space to another (outStaticVAO/
+// outStaticVBO, StaticVertex); both share outEBO. A stream with no vertices
+// gets no VAO or VBO.
 bool CreateMeshFromGLTF_PosUV_Textured(
     const char* path,
     GLuint& outVAO, GLuint& outVBO, GLuint& outEBO,
+    GLuint& outStaticVAO, GLuint& outStaticVBO,
     Mat4& outPreXform)
 {
     tinygltf::TinyGLTF loader;
@@ -304,114 +828,68 @@ bool CreateMeshFromGLTF_PosUV_Textured(
 
     gModelStatic = model;
 
-    gBaseTRS.assign(model.nodes.size(), NodeTRS{ {0,0,0},{0,0,0,1},{1,1,1} });
-    for (size_t i = 0; i < model.nodes.size(); ++i) {
-        const tinygltf::Node& n = model.nodes[i];
-        NodeTRS b; b.T[0] = b.T[1] = b.T[2] = 0.f; b.R[0] = b.R[1] = b.R[2] = 0.f; b.R[3] = 1.f; b.S[0] = b.S[1] = b.S[2] = 1.f;
-        if (n.translation.size() == 3) { b.T[0] = (float)n.translation[0]; b.T[1] = (float)n.translation[1]; b.T[2] = (float)n.translation[2]; }
-        if (n.rotation.size() == 4) { b.R[0] = (float)n.rotation[0];    b.R[1] = (float)n.rotation[1];    b.R[2] = (float)n.rotation[2];    b.R[3] = (float)n.rotation[3]; }
-        if (n.scale.size() == 3) { b.S[0] = (float)n.scale[0];       b.S[1] = (float)n.scale[1];       b.S[2] = (float)n.scale[2]; }
-        gBaseTRS[i] = b;
-    }
-    gGlobalsAnimated.assign(model.nodes.size(), matIdentity());
+    BuildFlatHierarchy(model, gHierarchy);
+    if (gHierarchy.count == 0) return false;
 
     gSkins.clear();
     gSkins.resize(model.skins.size());
+    gPaletteMatrices = 0;
     for (size_t si = 0; si < model.skins.size(); ++si) {
         const tinygltf::Skin& skin = model.skins[si];
         GLTFSkin S;
-        S.joints.assign(skin.joints.begin(), skin.joints.end());
+        S.joints.resize(skin.joints.size());
+        for (size_t j = 0; j < skin.joints.size(); ++j) {
+            int n = skin.joints[j];
+            S.joints[j] = (n >= 0 && n < (int)model.nodes.size()) ? gHierarchy.slotOf[(size_t)n] : -1;
+        }
         std::vector<float> ib; int comps = 0;
         if (skin.inverseBindMatrices >= 0) getAsFloat(model, skin.inverseBindMatrices, ib, comps);
-        S.invBind.resize(S.joints.size(), matIdentity());
+        S.invBind.resize(S.joints.size(), affineIdentity());
         for (size_t j = 0; j < S.joints.size(); ++j) {
             if ((int)ib.size() >= (int)((j + 1) * 16)) {
-                for (int k = 0; k < 16; ++k) S.invBind[j].m[k] = ib[j * 16 + k];
+                Mat4 M; for (int k = 0; k < 16; ++k) M.m[k] = ib[j * 16 + k];
+                S.invBind[j] = affineFromMat4(M);
             }
         }
+        S.paletteOffset = gPaletteMatrices;
+        gPaletteMatrices += (int)S.joints.size();
         gSkins[si] = S;
     }
 
-    gAnims.clear(); gIdleAnim = -1; gIdleDuration = 0.f;
+    gAnims.clear(); gBoneMasks.clear(); gIdleAnim = -1; gIdleDuration = 0.f; gMaxClipChannels = 0;
     for (size_t ai = 0; ai < model.animations.size(); ++ai) {
-        const tinygltf::Animation& a = model.animations[ai];
         GLTFAnimation A;
-        A.name = a.name;
-        A.samplers.resize(a.samplers.size());
-        for (size_t si = 0; si < a.samplers.size(); ++si) {
-            const tinygltf::AnimationSampler& s = a.samplers[si];
-            A.samplers[si].inputAcc = s.input;
-            A.samplers[si].outputAcc = s.output;
-            A.samplers[si].interp = s.interpolation.empty() ? "LINEAR" : s.interpolation;
-            if (s.output >= 0) {
-                const tinygltf::Accessor& acc = model.accessors[s.output];
-                A.samplers[si].comps = tinygltf::GetNumComponentsInType(acc.type);
-            }
-            A.samplers[si].srcModel = &gModelStatic;
-            float mt = AccessorMaxTime(model, s.input);
-            if (mt > A.durationSec) A.durationSec = mt;
-        }
-        for (size_t ci = 0; ci < a.channels.size(); ++ci) {
-            const tinygltf::AnimationChannel& c = a.channels[ci];
-            AnimChannel C;
-            C.sampler = c.sampler;
-            C.targetNode = c.target_node;
-            if (c.target_path == "translation") C.path = AP_Translation;
-            else if (c.target_path == "rotation") C.path = AP_Rotation;
-            else C.path = AP_Scale;
-            A.channels.push_back(C);
-        }
-        int idx = (int)gAnims.size();
-        gAnims.push_back(A);
+        DecodeAnimation(model, model.animations[ai], gHierarchy.slotOf, A);
+        int idx = AddAnimation(A);
         if (gIdleAnim < 0) gIdleAnim = idx;
         std::string low = A.name;
         for (size_t k = 0; k < low.size(); ++k) low[k] = (char)tolower((unsigned char)low[k]);
         if (!low.empty() && low.find("idle") != std::string::npos) gIdleAnim = idx;
     }
     if (gIdleAnim >= 0) gIdleDuration = gAnims[gIdleAnim].durationSec;
-    gActiveAnim = (gIdleAnim >= 0) ? gIdleAnim : (gAnims.empty() ? -1 : 0);
-    gActiveDuration = (gActiveAnim >= 0) ? gAnims[gActiveAnim].durationSec : 0.f;
-    gAnimT0 = 0.f;
 
     // collect mesh nodes
     struct MeshNode { int nodeIndex; int meshIndex; Mat4 WM; };
     std::vector<MeshNode> meshNodes;
 
-    std::vector<Mat4> globalXf;
-    ComputeGlobalTransforms(model, globalXf);
-
-    int sceneIndex = model.defaultScene >= 0 ? model.defaultScene : (model.scenes.empty() ? -1 : 0);
-    if (sceneIndex < 0) return false;
-
-    std::vector<int> stackNode;
-    std::vector<Mat4> stackMat;
-    for (size_t i = 0; i < model.scenes[sceneIndex].nodes.size(); ++i) {
-        stackNode.push_back(model.scenes[sceneIndex].nodes[i]);
-        stackMat.push_back(matIdentity());
-    }
-    while (!stackNode.empty()) {
-        int ni = stackNode.back(); stackNode.pop_back();
-        Mat4 parent = stackMat.back(); stackMat.pop_back();
+    std::vector<Affine3x4> globalXf((size_t)gHierarchy.count);
+    ComputeGlobalTransforms(gHierarchy, gHierarchy.rest.data(), globalXf.data());
 
-        const tinygltf::Node& node = model.nodes[ni];
-        Mat4 WM = matMul(parent, NodeLocalMatrix(node));
+    for (int slot = 0; slot < gHierarchy.count; ++slot) {
+        const tinygltf::Node& node = model.nodes[(size_t)gHierarchy.node[(size_t)slot]];
         if (node.mesh >= 0) {
-            MeshNode mn; mn.nodeIndex = ni; mn.meshIndex = node.mesh; mn.WM = WM;
+            MeshNode mn; mn.nodeIndex = gHierarchy.node[(size_t)slot]; mn.meshIndex = node.mesh; mn.WM = affineToMat4(globalXf[(size_t)slot]);
             meshNodes.push_back(mn);
         }
-        for (size_t c = 0; c < node.children.size(); ++c) {
-            stackNode.push_back(node.children[c]);
-            stackMat.push_back(WM);
-        }
     }
 
     std::vector<GLuint> texForTextureIdx(model.textures.size(), 0);
 
     // accumulators
-    std::vector<float>    interleaved; // pos3 uv2 j4 w4
-    std::vector<uint32_t> indices;
-    interleaved.reserve(1 << 20);
-    indices.reserve(1 << 20);
+    std::vector<SkinnedVertex> skinnedVerts;
+    std::vector<StaticVertex>  staticVerts;
+    std::vector<uint8_t> indexBytes;   // mixed 16/32-bit ranges, see AppendIndexRange
+    indexBytes.reserve(1 << 20);
 
     float minX = +FLT_MAX, minY = +FLT_MAX, minZ = +FLT_MAX;
     float maxX = -FLT_MAX, maxY = -FLT_MAX, maxZ = -FLT_MAX;
@@ -436,8 +914,6 @@ bool CreateMeshFromGLTF_PosUV_Textured(
             }
             int uvAcc = FindUVAccessor(prim, uvSet);
 
-            const uint32_t vbase = (uint32_t)(interleaved.size() / 13);
-
             std::vector<uint32_t> localIdx;
             if (prim.indices >= 0) {
                 const tinygltf::Accessor& acc = model.accessors[prim.indices];
@@ -465,7 +941,6 @@ bool CreateMeshFromGLTF_PosUV_Textured(
                 localIdx.resize((size_t)std::max(0, vertCount));
                 for (int i = 0; i < vertCount; ++i) localIdx[(size_t)i] = (uint32_t)i;
             }
-            for (size_t i = 0; i < localIdx.size(); ++i) localIdx[i] += vbase;
 
             std::vector<float> pos; int posComps = 0; getAsFloat(model, posAcc, pos, posComps);
             size_t vertCount = (posComps == 3) ? pos.size() / 3 : 0;
@@ -500,7 +975,7 @@ bool CreateMeshFromGLTF_PosUV_Textured(
                 for (size_t i = 0; i < vertCount; ++i) {
                     for (int c = 0; c < 4; ++c) {
                         int ji = (int)std::round(jn[i * 4 + c]);
-                        if (ji < 0 || (jointCount > 0 && ji >= (int)jointCount)) ji = 0;
+                        if (ji < 0 || ji > 255 || (jointCount > 0 && ji >= (int)jointCount)) ji = 0;
                         jn[i * 4 + c] = (float)ji;
                     }
                     float w0 = wt[i * 4 + 0]; if (w0 < 0.f) w0 = 0.f;
@@ -514,6 +989,62 @@ bool CreateMeshFromGLTF_PosUV_Textured(
                 }
             }
 
+            // Reorder the primitive's triangles and vertices; remap[i] is where
+            // source vertex i lands in the stream.
+            std::vector<uint32_t> remap(vertCount);
+            for (size_t i = 0; i < vertCount; ++i) remap[i] = (uint32_t)i;
+            bool triangles = (prim.mode == TINYGLTF_MODE_TRIANGLES || prim.mode < 0) && localIdx.size() % 3 == 0;
+            for (size_t i = 0; i < localIdx.size() && triangles; ++i) triangles = localIdx[i] < vertCount;
+            std::vector<uint32_t> lodIdx[GLTF_MAX_LODS];
+            float lodError[GLTF_MAX_LODS] = { 0.f };
+            int lodCount = 1;
+            if (gOptimizeMeshOrder && triangles && !localIdx.empty()) {
+                MeshOptStats before = mesh_opt_analyze(localIdx.data(), localIdx.size(), vertCount, pos.data(), 3);
+                mesh_opt_vertex_cache(localIdx.data(), localIdx.size(), vertCount);
+                const float overdraw = mesh_opt_overdraw(localIdx.data(), localIdx.size(), pos.data(), 3, vertCount, MESH_OPT_OVERDRAW_THRESHOLD);
+                MeshOptStats after = mesh_opt_analyze(localIdx.data(), localIdx.size(), vertCount, NULL, 0);
+                after.overdraw = overdraw;
+                std::fprintf(stderr, "[mesh] '%s' prim %zu: %zu tris, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overdraw %.3f -> %.3f\n",
+                    mesh.name.c_str(), pi, localIdx.size() / 3, before.acmr, after.acmr, before.atvr, after.atvr, before.overdraw, after.overdraw);
+            }
+            if (gMeshLodCount > 1 && triangles && !localIdx.empty()) {
+                // Skinned vertices collapse only onto ones with the same dominant joint.
+                std::vector<uint32_t> vertexClass;
+                if (hasSkin) {
+                    vertexClass.resize(vertCount);
+                    for (size_t i = 0; i < vertCount; ++i) {
+                        int best = 0;
+                        for (int c = 1; c < 4; ++c) if (wt[i * 4 + c] > wt[i * 4 + best]) best = c;
+                        vertexClass[i] = (uint32_t)jn[i * 4 + best];
+                    }
+                }
+                const int maxLods = std::min(gMeshLodCount, GLTF_MAX_LODS);
+                const std::vector<uint32_t>* prev = &localIdx;
+                for (int l = 1; l < maxLods; ++l) {
+                    std::vector<uint32_t>& dst = lodIdx[l];
+                    dst.resize(prev->size());
+                    const size_t target = (size_t)(localIdx.size() / 3 * kLodIndexRatio[l]) * 3;
+                    dst.resize(mesh_opt_simplify(dst.data(), prev->data(), prev->size(), pos.data(), 3, vertCount,
+                        hasSkin ? vertexClass.data() : NULL, target, kLodMaxError[l], &lodError[l]));
+                    if (dst.empty() || dst.size() * 10 > prev->size() * 9) { dst.clear(); break; }
+                    if (gOptimizeMeshOrder) mesh_opt_vertex_cache(dst.data(), dst.size(), vertCount);
+                    lodError[l] = std::max(lodError[l], lodError[l - 1]);
+                    prev = &dst;
+                    lodCount = l + 1;
+                }
+                std::fprintf(stderr, "[mesh] '%s' prim %zu: %d LODs,", mesh.name.c_str(), pi, lodCount);
+                for (int l = 1; l < lodCount; ++l) std::fprintf(stderr, " %zu tris (err %.4f)", lodIdx[l].size() / 3, lodError[l]);
+                std::fprintf(stderr, "\n");
+            }
+            if (gOptimizeMeshOrder && triangles && !localIdx.empty()) {
+                // Fetch order follows LOD 0; coarser LODs use a subset of its vertices.
+                mesh_opt_vertex_fetch_remap(remap.data(), localIdx.data(), localIdx.size(), vertCount);
+                for (size_t i = 0; i < localIdx.size(); ++i) localIdx[i] = remap[localIdx[i]];
+                for (int l = 1; l < lodCount; ++l) {
+                    for (size_t i = 0; i < lodIdx[l].size(); ++i) lodIdx[l][i] = remap[lodIdx[l][i]];
+                }
+            }
+
             float factor[4] = { 1,1,1,1 };
             GLuint tex = 0;
             if (prim.material >= 0 && prim.material < (int)model.materials.size()) {
@@ -524,12 +1055,17 @@ bool CreateMeshFromGLTF_PosUV_Textured(
                 tex = GetMaterialBaseColorTexture(texForTextureIdx, model, prim.material);
             }
 
-            size_t indexOffset = indices.size();
-            indices.insert(indices.end(), localIdx.begin(), localIdx.end());
+            // Indices stay relative to the primitive; vbase is applied as the
+            // draw's base vertex, so any primitive under 64K vertices gets 16-bit indices.
+            const uint32_t vbase = (uint32_t)(hasSkin ? skinnedVerts.size() : staticVerts.size());
+            const GLenum indexType = (vertCount <= 0x10000) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            lodIdx[0].swap(localIdx);
+            size_t lodByteOffset[GLTF_MAX_LODS] = { 0 };
+            for (int l = 0; l < lodCount; ++l) lodByteOffset[l] = AppendIndexRange(indexBytes, lodIdx[l], indexType);
 
-            size_t base = interleaved.size();
-            interleaved.resize(base + vertCount * 13);
-            float* dst = interleaved.data() + base;
+            if (hasSkin) skinnedVerts.resize(vbase + vertCount);
+            else         staticVerts.resize(vbase + vertCount);
+            int maxInfluences = 0;
 
             for (size_t i = 0; i < vertCount; ++i) {
                 float x = pos[i * 3 + 0], y = pos[i * 3 + 1], z = pos[i * 3 + 2];
@@ -541,27 +1077,41 @@ bool CreateMeshFromGLTF_PosUV_Textured(
                 float vx = x, vy = y, vz = z;
                 if (!hasSkin) xformPoint(WM, x, y, z, vx, vy, vz);
 
-                dst[0] = vx; dst[1] = vy; dst[2] = vz;
-                dst[3] = (uvComps == 2) ? uv[i * 2 + 0] : 0.f;
-                dst[4] = (uvComps == 2) ? uv[i * 2 + 1] : 0.f;
+                const uint16_t u = FloatToHalf((uvComps == 2) ? uv[i * 2 + 0] : 0.f);
+                const uint16_t v = FloatToHalf((uvComps == 2) ? uv[i * 2 + 1] : 0.f);
 
                 if (hasSkin) {
-                    dst[5] = jn[i * 4 + 0]; dst[6] = jn[i * 4 + 1]; dst[7] = jn[i * 4 + 2]; dst[8] = jn[i * 4 + 3];
-                    dst[9] = wt[i * 4 + 0]; dst[10] = wt[i * 4 + 1]; dst[11] = wt[i * 4 + 2]; dst[12] = wt[i * 4 + 3];
+                    SkinnedVertex& dst = skinnedVerts[vbase + remap[i]];
+                    dst.pos[0] = vx; dst.pos[1] = vy; dst.pos[2] = vz;
+                    dst.uv[0] = u; dst.uv[1] = v;
+                    for (int c = 0; c < 4; ++c) dst.joints[c] = (uint8_t)jn[i * 4 + c];
+                    QuantizeWeights(&wt[i * 4], dst.weights);
+                    maxInfluences = std::max(maxInfluences, SortInfluences(dst.joints, dst.weights));
                 }
                 else {
-                    dst[5] = 0; dst[6] = 0; dst[7] = 0; dst[8] = 0;
-                    dst[9] = 1; dst[10] = 0; dst[11] = 0; dst[12] = 0;
+                    StaticVertex& dst = staticVerts[vbase + remap[i]];
+                    dst.pos[0] = vx; dst.pos[1] = vy; dst.pos[2] = vz;
+                    dst.uv[0] = u; dst.uv[1] = v;
                 }
-                dst += 13;
             }
 
             GLTFDraw d;
-            d.indexCount = (GLsizei)localIdx.size();
-            d.indexOffset = (GLsizei)indexOffset;
+            if (hasSkin) ComputeDrawBounds(d, skinnedVerts.data() + vbase, sizeof(SkinnedVertex), (int)vertCount);
+            else         ComputeDrawBounds(d, staticVerts.data() + vbase, sizeof(StaticVertex), (int)vertCount);
+            for (int l = 0; l < lodCount; ++l) {
+                d.lods[l].indexCount = (GLsizei)lodIdx[l].size();
+                d.lods[l].indexByteOffset = lodByteOffset[l];
+                d.lods[l].error = lodError[l];
+            }
+            d.lodCount = lodCount;
+            d.indexType = indexType;
+            d.vertexOffset = (int)vbase;
+            d.vertexCount = (int)vertCount;
             d.texture = tex;
             d.baseColor[0] = factor[0]; d.baseColor[1] = factor[1]; d.baseColor[2] = factor[2]; d.baseColor[3] = factor[3];
             d.skinned = hasSkin;
+            d.maxInfluences = hasSkin ? maxInfluences : 0;
+            d.shaderKey = MeshShaderKey(hasSkin, maxInfluences, false);
             d.skinIndex = hasSkin ? skinIndex : -1;
             d.localModel = hasSkin ? WM : matIdentity();
 
@@ -570,12 +1120,13 @@ bool CreateMeshFromGLTF_PosUV_Textured(
                 int jointCount = (int)skin.joints.size();
                 d.bones16.resize((size_t)jointCount * 16);
                 d.boneCount = jointCount;
+                ComputeJointBounds(d, skinnedVerts.data() + vbase, (int)vertCount);
 
                 std::vector<float> invBind; int ibComps = 0;
                 if (skin.inverseBindMatrices >= 0) getAsFloat(model, skin.inverseBindMatrices, invBind, ibComps);
                 for (int j = 0; j < jointCount; ++j) {
-                    int jointNode = skin.joints[(size_t)j];
-                    Mat4 G = globalXf[(size_t)jointNode];
+                    int jointSlot = gSkins[(size_t)skinIndex].joints[(size_t)j];
+                    Mat4 G = (jointSlot >= 0) ? affineToMat4(globalXf[(size_t)jointSlot]) : matIdentity();
                     Mat4 IB = matIdentity();
                     if ((int)invBind.size() >= (j + 1) * 16) {
                         for (int k = 0; k < 16; ++k) IB.m[k] = invBind[j * 16 + k];
@@ -610,28 +1161,51 @@ bool CreateMeshFromGLTF_PosUV_Textured(
 
     gModelFitRadius *= s;
 
-    glGenVertexArrays(1, &outVAO);
-    glBindVertexArray(outVAO);
-
-    glGenBuffers(1, &outVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, outVBO);
-    glBufferData(GL_ARRAY_BUFFER, interleaved.size() * sizeof(float), interleaved.data(), GL_STATIC_DRAW);
-
+    // Filled through the copy target; the element binding belongs to a VAO.
     glGenBuffers(1, &outEBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, outEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
-
-    const GLsizei stride = (GLsizei)(13 * sizeof(float));
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)((3 + 2) * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)((3 + 2 + 4) * sizeof(float)));
-    glEnableVertexAttribArray(3);
-
-    glBindVertexArray(0);
+    BindBuffer(GL_COPY_WRITE_BUFFER, outEBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexBytes.size(), indexBytes.data(), GL_STATIC_DRAW);
+
+    outVAO = outVBO = outStaticVAO = outStaticVBO = 0;
+    if (!skinnedVerts.empty()) {
+        glGenVertexArrays(1, &outVAO);
+        BindVAO(outVAO);
+        glGenBuffers(1, &outVBO);
+        BindBuffer(GL_ARRAY_BUFFER, outVBO);
+        glBufferData(GL_ARRAY_BUFFER, skinnedVerts.size() * sizeof(SkinnedVertex), skinnedVerts.data(), GL_STATIC_DRAW);
+        BindBuffer(GL_ELEMENT_ARRAY_BUFFER, outEBO);
+
+        const GLsizei stride = (GLsizei)sizeof(SkinnedVertex);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(SkinnedVertex, pos));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(SkinnedVertex, uv));
+        glEnableVertexAttribArray(1);
+        glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(SkinnedVertex, joints));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(SkinnedVertex, weights));
+        glEnableVertexAttribArray(3);
+    }
+    if (!staticVerts.empty()) {
+        glGenVertexArrays(1, &outStaticVAO);
+        BindVAO(outStaticVAO);
+        glGenBuffers(1, &outStaticVBO);
+        BindBuffer(GL_ARRAY_BUFFER, outStaticVBO);
+        glBufferData(GL_ARRAY_BUFFER, staticVerts.size() * sizeof(StaticVertex), staticVerts.data(), GL_STATIC_DRAW);
+        BindBuffer(GL_ELEMENT_ARRAY_BUFFER, outEBO);
+
+        const GLsizei stride = (GLsizei)sizeof(StaticVertex);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(StaticVertex, pos));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(StaticVertex, uv));
+        glEnableVertexAttribArray(1);
+    }
+    BindVAO(0);
+
+    std::fprintf(stderr, "[mesh] %zu skinned x %zu B + %zu static x %zu B vertices, %zu KB\n",
+        skinnedVerts.size(), sizeof(SkinnedVertex), staticVerts.size(), sizeof(StaticVertex),
+        (skinnedVerts.size() * sizeof(SkinnedVertex) + staticVerts.size() * sizeof(StaticVertex)) / 1024);
+    gSkinnedVertices.swap(skinnedVerts);
+    gStaticVertices.swap(staticVerts);
     return true;
 }
 
@@ -644,20 +1218,34 @@ void normalizeQ(float q[4]) {
     if (L > 1e-8f) { q[0] /= L; q[1] /= L; q[2] /= L; q[3] /= L; }
 }
 
-void sampleVec3(const std::vector<float>& times, const std::vector<float>& vals, float t, float out[3], bool step) {
-    if (times.empty() || vals.empty()) { out[0] = out[1] = out[2] = 0.f; return; }
-    if (t <= times.front()) { out[0] = vals[0]; out[1] = vals[1]; out[2] = vals[2]; return; }
-    if (t >= times.back()) { size_t n = vals.size(); out[0] = vals[n - 3]; out[1] = vals[n - 2]; out[2] = vals[n - 1]; return; }
-    size_t i = 1; while (i<times.size() && t>times[i]) ++i; size_t i0 = i - 1, i1 = i;
+// Returns i0 with times[i0] < t <= times[i0 + 1] (i0 = 0 also covers t == times[0]);
+// callers clamp t to the open key range first. The cursor holds the last segment:
+// normal playback advances it a few steps in O(1), seeks and loop wraps binary-search.
+uint32_t FindKeySegment(const float* times, uint32_t count, float t, uint32_t& cursor) {
+    uint32_t i = cursor;
+    if (i + 1 < count && (i == 0 || times[i] < t)) {
+        for (int n = 0; n < 4 && i + 2 < count && t > times[i + 1]; ++n) ++i;
+        if (t <= times[i + 1]) { cursor = i; return i; }
+    }
+    i = (uint32_t)(std::lower_bound(times + 1, times + count, t) - times) - 1;
+    cursor = i;
+    return i;
+}
+
+void sampleVec3(const float* times, const float* vals, uint32_t count, float t, float out[3], bool step, uint32_t& cursor) {
+    if (count == 0) { out[0] = out[1] = out[2] = 0.f; return; }
+    if (t <= times[0]) { out[0] = vals[0]; out[1] = vals[1]; out[2] = vals[2]; return; }
+    if (t >= times[count - 1]) { const float* v = vals + (size_t)(count - 1) * 3; out[0] = v[0]; out[1] = v[1]; out[2] = v[2]; return; }
+    uint32_t i0 = FindKeySegment(times, count, t, cursor), i1 = i0 + 1;
     float u = step ? 0.f : (t - times[i0]) / std::max(1e-6f, times[i1] - times[i0]);
     for (int c = 0; c < 3; ++c) { float a = vals[i0 * 3 + c], b = vals[i1 * 3 + c]; out[c] = a * (1.f - u) + b * u; }
 }
 
-void sampleQuat(const std::vector<float>& times, const std::vector<float>& vals, float t, float out[4], bool step) {
-    if (times.empty() || vals.empty()) { out[0] = out[1] = out[2] = 0.f; out[3] = 1.f; return; }
-    if (t <= times.front()) { out[0] = vals[0]; out[1] = vals[1]; out[2] = vals[2]; out[3] = vals[3]; normalizeQ(out); return; }
-    if (t >= times.back()) { size_t n = vals.size(); out[0] = vals[n - 4]; out[1] = vals[n - 3]; out[2] = vals[n - 2]; out[3] = vals[n - 1]; normalizeQ(out); return; }
-    size_t i = 1; while (i<times.size() && t>times[i]) ++i; size_t i0 = i - 1, i1 = i;
+void sampleQuat(const float* times, const float* vals, uint32_t count, float t, float out[4], bool step, uint32_t& cursor) {
+    if (count == 0) { out[0] = out[1] = out[2] = 0.f; out[3] = 1.f; return; }
+    if (t <= times[0]) { out[0] = vals[0]; out[1] = vals[1]; out[2] = vals[2]; out[3] = vals[3]; normalizeQ(out); return; }
+    if (t >= times[count - 1]) { const float* v = vals + (size_t)(count - 1) * 4; out[0] = v[0]; out[1] = v[1]; out[2] = v[2]; out[3] = v[3]; normalizeQ(out); return; }
+    uint32_t i0 = FindKeySegment(times, count, t, cursor), i1 = i0 + 1;
     if (step) { for (int c = 0; c < 4; ++c) out[c] = vals[i0 * 4 + c]; normalizeQ(out); return; }
     float q0[4] = { vals[i0 * 4 + 0], vals[i0 * 4 + 1], vals[i0 * 4 + 2], vals[i0 * 4 + 3] };
     float q1[4] = { vals[i1 * 4 + 0], vals[i1 * 4 + 1], vals[i1 * 4 + 2], vals[i1 * 4 + 3] };
@@ -672,6 +1260,35 @@ void sampleQuat(const std::vector<float>& times, const std::vector<float>& vals,
     for (int c = 0; c < 4; ++c) out[c] = q0[c] * s0 + q1[c] * s1;
 }
 
+// Quantized tracks: 3 x uint16 per key in the clip's packed store.
+static void DequantVec3(const AnimChannel& C, const uint16_t* p, float out[3]) {
+    out[0] = C.qMin[0] + (float)p[0] * C.qStep[0];
+    out[1] = C.qMin[1] + (float)p[1] * C.qStep[1];
+    out[2] = C.qMin[2] + (float)p[2] * C.qStep[2];
+}
+
+void sampleVec3Q(const AnimChannel& C, const float* times, const uint16_t* vals, float t, float out[3], uint32_t& cursor) {
+    const uint32_t count = C.keyCount;
+    if (count == 0) { out[0] = out[1] = out[2] = 0.f; return; }
+    if (t <= times[0]) { DequantVec3(C, vals, out); return; }
+    if (t >= times[count - 1]) { DequantVec3(C, vals + (size_t)(count - 1) * 3, out); return; }
+    uint32_t i0 = FindKeySegment(times, count, t, cursor), i1 = i0 + 1;
+    float a[3], b[3]; DequantVec3(C, vals + (size_t)i0 * 3, a); DequantVec3(C, vals + (size_t)i1 * 3, b);
+    float u = C.step ? 0.f : (t - times[i0]) / std::max(1e-6f, times[i1] - times[i0]);
+    for (int c = 0; c < 3; ++c) out[c] = a[c] * (1.f - u) + b[c] * u;
+}
+
+void sampleQuatQ(const AnimChannel& C, const float* times, const uint16_t* vals, float t, float out[4], uint32_t& cursor) {
+    const uint32_t count = C.keyCount;
+    if (count == 0) { out[0] = out[1] = out[2] = 0.f; out[3] = 1.f; return; }
+    if (t <= times[0]) { UnpackQuat48(vals, out); return; }
+    if (t >= times[count - 1]) { UnpackQuat48(vals + (size_t)(count - 1) * 3, out); return; }
+    uint32_t i0 = FindKeySegment(times, count, t, cursor), i1 = i0 + 1;
+    float q0[4], q1[4]; UnpackQuat48(vals + (size_t)i0 * 3, q0); UnpackQuat48(vals + (size_t)i1 * 3, q1);
+    if (C.step) { out[0] = q0[0]; out[1] = q0[1]; out[2] = q0[2]; out[3] = q0[3]; return; }
+    slerpQ(q0, q1, (t - times[i0]) / std::max(1e-6f, times[i1] - times[i0]), out);
+}
+
 static void slerpQ(const float a[4], const float bIn[4], float u, float out[4]) {
     float b[4] = { bIn[0], bIn[1], bIn[2], bIn[3] };
     float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
@@ -693,152 +1310,424 @@ static void slerpQ(const float a[4], const float bIn[4], float u, float out[4])
     out[3] = a[3] * s0 + b[3] * s1;
 }
 
-static void SampleAnimationPose(const tinygltf::Model& model, const GLTFAnimation& A, float tLocal, std::vector<NodeTRS>& out) {
-    out = gBaseTRS;
+static void mulQ(const float a[4], const float b[4], float out[4]) {
+    out[0] = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+    out[1] = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+    out[2] = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+    out[3] = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+}
+
+// v gets 3 floats for T/S, 4 for R.
+static void SampleChannel(const GLTFAnimation& A, const AnimChannel& C, float t, uint32_t& cursor, float v[4]) {
+    const float* times = A.keys.data() + C.timesOfs;
+    if (C.quantized) {
+        const uint16_t* q = A.packed.data() + C.valuesOfs;
+        if (C.path == AP_Rotation) sampleQuatQ(C, times, q, t, v, cursor);
+        else                       sampleVec3Q(C, times, q, t, v, cursor);
+    }
+    else {
+        const float* vals = A.keys.data() + C.valuesOfs;
+        if (C.path == AP_Rotation) sampleQuat(times, vals, C.keyCount, t, v, C.step, cursor);
+        else                       sampleVec3(times, vals, C.keyCount, t, v, C.step, cursor);
+    }
+}
+
+static size_t PoseStreamBase(AnimPath path, size_t N) {
+    return (path == AP_Translation) ? PS_TX * N : (path == AP_Rotation) ? PS_QX * N : PS_SX * N;
+}
+
+// out is an SoA pose of gHierarchy.count slots.
+static void SampleAnimationPose(const GLTFAnimation& A, float tLocal, uint32_t* cursors, float* out) {
+    const size_t N = (size_t)gHierarchy.count;
+    std::memcpy(out, gHierarchy.rest.data(), N * POSE_STREAMS * sizeof(float));
     for (size_t ch = 0; ch < A.channels.size(); ++ch) {
         const AnimChannel& C = A.channels[ch];
-        if (C.targetNode < 0) continue;
-        const AnimSampler& S = A.samplers[(size_t)C.sampler];
-        const tinygltf::Model& src = S.srcModel ? *S.srcModel : model;
+        float v[4]; SampleChannel(A, C, tLocal, cursors[ch], v);
+        float* dst = out + PoseStreamBase(C.path, N) + (size_t)C.targetSlot;
+        dst[0] = v[0]; dst[N] = v[1]; dst[2 * N] = v[2];
+        if (C.path == AP_Rotation) dst[3 * N] = v[3];
+    }
+}
 
-        std::vector<float> times; int tComps = 0; getAsFloat(src, S.inputAcc, times, tComps);
-        std::vector<float> vals;  int vComps = 0; getAsFloat(src, S.outputAcc, vals, vComps);
-        bool step = (S.interp == "STEP");
+// Moves one slot's path toward v by w.
+static void BlendPoseValue(float* pose, size_t N, size_t slot, AnimPath path, const float* v, float w) {
+    float* dst = pose + PoseStreamBase(path, N) + slot;
+    if (path == AP_Rotation) {
+        float a[4] = { dst[0], dst[N], dst[2 * N], dst[3 * N] };
+        float q[4]; slerpQ(a, v, w, q);
+        dst[0] = q[0]; dst[N] = q[1]; dst[2 * N] = q[2]; dst[3 * N] = q[3];
+        return;
+    }
+    dst[0] = dst[0] * (1.f - w) + v[0] * w;
+    dst[N] = dst[N] * (1.f - w) + v[1] * w;
+    dst[2 * N] = dst[2 * N] * (1.f - w) + v[2] * w;
+}
 
+// Override layer: only the clip's own channels are sampled. Masked slots a
+// compressed clip leaves at rest blend toward rest, as the full pose would,
+// but only where a lower layer has moved them (touched: AnimPath bits per slot).
+static void BlendOverrideLayer(const GLTFAnimation& A, float tLocal, uint32_t* cursors, const BoneMask* M, float w, float* pose, uint8_t* touched) {
+    const size_t N = (size_t)gHierarchy.count;
+    for (size_t ch = 0; ch < A.channels.size(); ++ch) {
+        const AnimChannel& C = A.channels[ch];
+        float wm = M ? w * M->weight[(size_t)C.targetSlot] : w;
+        if (wm <= 0.f) continue;
+        float v[4]; SampleChannel(A, C, tLocal, cursors[ch], v);
+        BlendPoseValue(pose, N, (size_t)C.targetSlot, C.path, v, wm);
+        touched[C.targetSlot] |= (uint8_t)(1 << C.path);
+    }
+    const float* rest = gHierarchy.rest.data();
+    const size_t count = M ? M->slots.size() : N;
+    for (size_t k = 0; k < count; ++k) {
+        const size_t slot = M ? (size_t)M->slots[k] : k;
+        const uint8_t moved = (uint8_t)(touched[slot] & ~A.slotPaths[slot]);
+        if (!moved) continue;
+        float wm = M ? w * M->weight[slot] : w;
+        for (int p = AP_Translation; p <= AP_Scale; ++p) {
+            if (!(moved & (1 << p))) continue;
+            const float* r = rest + PoseStreamBase((AnimPath)p, N) + slot;
+            float v[4] = { r[0], r[N], r[2 * N], (p == AP_Rotation) ? r[3 * N] : 0.f };
+            BlendPoseValue(pose, N, slot, (AnimPath)p, v, wm);
+        }
+    }
+}
+
+// Additive layer: adds w times each channel's offset from the clip's first
+// frame. Rotations apply the offset in the joint's local frame.
+static void AddAdditiveLayer(const GLTFAnimation& A, float tLocal, uint32_t* cursors, const BoneMask* M, float w, float* pose, uint8_t* touched) {
+    const size_t N = (size_t)gHierarchy.count;
+    static const float identity[4] = { 0.f, 0.f, 0.f, 1.f };
+    for (size_t ch = 0; ch < A.channels.size(); ++ch) {
+        const AnimChannel& C = A.channels[ch];
+        float wm = M ? w * M->weight[(size_t)C.targetSlot] : w;
+        if (wm <= 0.f) continue;
+        float v[4]; SampleChannel(A, C, tLocal, cursors[ch], v);
+        const float* ref = &A.additiveRef[ch * 4];
+        touched[C.targetSlot] |= (uint8_t)(1 << C.path);
+        float* dst = pose + PoseStreamBase(C.path, N) + (size_t)C.targetSlot;
         if (C.path == AP_Translation) {
-            float v[3]; sampleVec3(times, vals, tLocal, v, step);
-            out[(size_t)C.targetNode].T[0] = v[0]; out[(size_t)C.targetNode].T[1] = v[1]; out[(size_t)C.targetNode].T[2] = v[2];
+            for (int c = 0; c < 3; ++c) dst[(size_t)c * N] += (v[c] - ref[c]) * wm;
         }
         else if (C.path == AP_Scale) {
-            float v[3]; sampleVec3(times, vals, tLocal, v, step);
-            out[(size_t)C.targetNode].S[0] = v[0]; out[(size_t)C.targetNode].S[1] = v[1]; out[(size_t)C.targetNode].S[2] = v[2];
+            for (int c = 0; c < 3; ++c) if (std::fabs(ref[c]) > 1e-6f) dst[(size_t)c * N] *= 1.f + (v[c] / ref[c] - 1.f) * wm;
         }
         else {
-            float q[4]; sampleQuat(times, vals, tLocal, q, step);
-            out[(size_t)C.targetNode].R[0] = q[0]; out[(size_t)C.targetNode].R[1] = q[1]; out[(size_t)C.targetNode].R[2] = q[2]; out[(size_t)C.targetNode].R[3] = q[3];
+            const float refInv[4] = { -ref[0], -ref[1], -ref[2], ref[3] };
+            float delta[4], part[4], q[4];
+            mulQ(refInv, v, delta);
+            slerpQ(identity, delta, wm, part);
+            const float a[4] = { dst[0], dst[N], dst[2 * N], dst[3 * N] };
+            mulQ(a, part, q);
+            normalizeQ(q);
+            dst[0] = q[0]; dst[N] = q[1]; dst[2 * N] = q[2]; dst[3 * N] = q[3];
         }
     }
 }
 
-void GLTF_CrossfadeToAnimationByIndex(int idx, float nowSec, float durationSec, bool syncNormalizedPhase) {
-    if (idx < 0 || idx >= (int)gAnims.size()) return;
-    if (gActiveAnim == idx) return;
+// ============================================================
+// Animation instances
 
-    int from = gActiveAnim;
-    int to = idx;
+// Once per pose update, so draws sharing a skin share its palette.
+static void BuildSkinPalettes(AnimInstance* inst) {
+    for (size_t si = 0; si < gSkins.size(); ++si) {
+        const GLTFSkin& S = gSkins[si];
+        float* out = inst->palette + (size_t)S.paletteOffset * 16;
+        for (size_t j = 0; j < S.joints.size(); ++j) {
+            int slot = S.joints[j];
+            Mat4 B = affineToMat4((slot >= 0) ? affineMul(inst->globals[(size_t)slot], S.invBind[j]) : S.invBind[j]);
+            std::memcpy(out + j * 16, B.m, 16 * sizeof(float));
+        }
+    }
+}
+
+// Scratch GLTF_UpdateAnimation_Pose takes from its frame arena: the pose
+// streams and a touched flag per slot, plus alignment padding.
+size_t GLTF_PoseScratchBytes() {
+    const size_t N = (size_t)gHierarchy.count;
+    return N * POSE_STREAMS * sizeof(float) + N + 32;
+}
+
+size_t GLTF_AnimInstanceBytes() {
+    return sizeof(AnimInstance) + (size_t)gHierarchy.count * sizeof(Affine3x4) + (size_t)gPaletteMatrices * 16 * sizeof(float) +
+        ANIM_MAX_LAYERS * (size_t)gMaxClipChannels * sizeof(uint32_t);
+}
+
+// Call after every clip is loaded: the cursor blocks are sized for the
+// largest clip at this point.
+bool GLTF_CreateAnimInstance(AnimInstance* inst, MemoryArena* arena) {
+    const size_t globalsBytes = (size_t)gHierarchy.count * sizeof(Affine3x4);
+    const size_t paletteBytes = (size_t)gPaletteMatrices * 16 * sizeof(float);
+    const size_t cursorBytes = (size_t)gMaxClipChannels * sizeof(uint32_t);
+    unsigned char* block = (unsigned char*)arena_alloc(arena, globalsBytes + paletteBytes + ANIM_MAX_LAYERS * cursorBytes);
+    if (!block) return false;
+
+    *inst = AnimInstance();
+    inst->globals = (Affine3x4*)block;
+    inst->palette = (float*)(block + globalsBytes);
+    unsigned char* cursors = block + globalsBytes + paletteBytes;
+    for (int i = 0; i < ANIM_MAX_LAYERS; ++i) inst->layers[i].cursors = (uint32_t*)(cursors + (size_t)i * cursorBytes);
+    std::memset(cursors, 0, ANIM_MAX_LAYERS * cursorBytes);
+    ComputeGlobalTransforms(gHierarchy, gHierarchy.rest.data(), inst->globals);
+    BuildSkinPalettes(inst);
+    return true;
+}
+
+void GLTF_DestroyAnimInstance(AnimInstance* inst, MemoryArena* arena) {
+    arena_free(arena, inst->globals);
+    *inst = AnimInstance();
+}
+
+static float AnimLayerWeight(const AnimLayer& L, float tSec) {
+    float u = (L.fadeDur > 1e-6f) ? (tSec - L.fadeStart) / L.fadeDur : 1.f;
+    if (u < 0.f) u = 0.f; if (u > 1.f) u = 1.f;
+    return L.weightFrom + (L.weightTo - L.weightFrom) * u;
+}
+
+static float AnimLayerLocalTime(const AnimLayer& L, float tSec) {
+    float dur = gAnims[(size_t)L.clip].durationSec;
+    float t = std::max(0.f, tSec - L.t0);
+    return (dur > 0.f) ? std::fmod(t, dur) : t;
+}
 
-    gBlendFrom = from;
-    gBlendTo = to;
-    gBlendStart = nowSec;
-    gBlendDur = durationSec > 0.f ? durationSec : 0.f;
-    gBlendFromT0 = gAnimT0;
+static bool IsBaseLayer(const AnimLayer& L) { return L.mode == ABM_Override && L.mask < 0; }
 
-    float toDur = gAnims[(size_t)to].durationSec;
+// Topmost whole-body override layer, -1 if there is none.
+static int AnimBaseLayer(const AnimInstance* inst) {
+    for (int i = inst->layerCount - 1; i >= 0; --i) if (IsBaseLayer(inst->layers[i])) return i;
+    return -1;
+}
+
+// The removed layer's cursor block moves to the free end of the array.
+static void RemoveAnimLayer(AnimInstance* inst, int at) {
+    uint32_t* cursors = inst->layers[at].cursors;
+    for (int i = at; i + 1 < inst->layerCount; ++i) inst->layers[i] = inst->layers[i + 1];
+    --inst->layerCount;
+    inst->layers[inst->layerCount] = AnimLayer();
+    inst->layers[inst->layerCount].cursors = cursors;
+}
+
+// Layer a full stack can give up at nowSec, or -1. In order: one whose
+// fade-out has finished, a base hidden under a full-weight base, the
+// lowest masked or additive layer. The topmost base always stays, and so
+// do bases under it mid-crossfade.
+static int AnimLayerToEvict(const AnimInstance* inst, float nowSec) {
+    const int base = AnimBaseLayer(inst);
+    for (int i = 0; i < inst->layerCount; ++i) {
+        const AnimLayer& L = inst->layers[i];
+        if (i != base && L.weightTo <= 0.f && nowSec >= L.fadeStart + L.fadeDur) return i;
+    }
+    if (base > 0 && AnimLayerWeight(inst->layers[base], nowSec) >= 1.f) {
+        for (int i = 0; i < base; ++i) if (IsBaseLayer(inst->layers[i])) return i;
+    }
+    for (int i = 0; i < inst->layerCount; ++i) if (!IsBaseLayer(inst->layers[i])) return i;
+    return -1;
+}
+
+// A full stack evicts a layer (see AnimLayerToEvict) to make room; NULL
+// when none can go.
+static AnimLayer* InsertAnimLayer(AnimInstance* inst, int at, float nowSec) {
+    if (inst->layerCount == ANIM_MAX_LAYERS) {
+        const int victim = AnimLayerToEvict(inst, nowSec);
+        if (victim < 0) return NULL;
+        RemoveAnimLayer(inst, victim);
+        if (victim < at) --at;
+    }
+    uint32_t* cursors = inst->layers[inst->layerCount].cursors;
+    for (int i = inst->layerCount; i > at; --i) inst->layers[i] = inst->layers[i - 1];
+    ++inst->layerCount;
+    AnimLayer& L = inst->layers[at];
+    L = AnimLayer();
+    L.cursors = cursors;
+    std::memset(cursors, 0, (size_t)gMaxClipChannels * sizeof(uint32_t));
+    return &L;
+}
+
+// Copies dst's layers and clocks from src, e.g. to bring a new crowd member in step.
+void GLTF_SyncAnimInstance(AnimInstance* dst, const AnimInstance* src) {
+    dst->layerCount = src->layerCount;
+    for (int i = 0; i < ANIM_MAX_LAYERS; ++i) {
+        uint32_t* cursors = dst->layers[i].cursors;
+        dst->layers[i] = src->layers[i];
+        dst->layers[i].cursors = cursors;
+        std::memset(cursors, 0, (size_t)gMaxClipChannels * sizeof(uint32_t));
+    }
+}
+
+// Makes idx the base clip at full weight, replacing the base and anything under it.
+static void SetBaseAnimation(AnimInstance* inst, int idx, float t0, float nowSec) {
+    for (int base = AnimBaseLayer(inst); base >= 0; --base) RemoveAnimLayer(inst, 0);
+    AnimLayer* L = InsertAnimLayer(inst, 0, nowSec);   // only masked or additive layers are left to evict
+    if (!L) return;
+    L->clip = idx;
+    L->t0 = t0;
+    L->weightFrom = L->weightTo = 1.f;
+}
+
+// Fades a new base layer in over the current one; layers above the base
+// (masked or additive) keep playing on top.
+void GLTF_CrossfadeToAnimationByIndex(AnimInstance* inst, int idx, float nowSec, float durationSec, bool syncNormalizedPhase) {
+    if (idx < 0 || idx >= (int)gAnims.size()) return;
+    const int base = AnimBaseLayer(inst);
+    const int from = (base >= 0) ? inst->layers[base].clip : -1;
+    if (from == idx) return;
+
+    float toT0 = nowSec;
+    float toDur = gAnims[(size_t)idx].durationSec;
     if (syncNormalizedPhase && from >= 0) {
         float fromDur = gAnims[(size_t)from].durationSec;
-        float tFromLocal = (fromDur > 0.f) ? std::fmod(std::max(0.f, nowSec - gAnimT0), fromDur) : std::max(0.f, nowSec - gAnimT0);
+        float tFromLocal = AnimLayerLocalTime(inst->layers[base], nowSec);
         float phase = (fromDur > 1e-6f) ? (tFromLocal / fromDur) : 0.f;
         float tToLocal = (toDur > 1e-6f) ? (phase * toDur) : 0.f;
-        gBlendToT0 = nowSec - tToLocal;
+        toT0 = nowSec - tToLocal;
     }
-    else {
-        gBlendToT0 = nowSec;
+
+    AnimLayer* L = (from >= 0 && durationSec > 0.f) ? InsertAnimLayer(inst, base + 1, nowSec) : NULL;
+    if (!L) {
+        // No fade asked for, or a stack of bases all mid-crossfade: cut to it.
+        SetBaseAnimation(inst, idx, toT0, nowSec);
+        return;
     }
+    L->clip = idx;
+    L->t0 = toT0;
+    L->weightFrom = 0.f;
+    L->weightTo = 1.f;
+    L->fadeStart = nowSec;
+    L->fadeDur = durationSec;
+}
+
+// Pushes a layer on top of the stack, fading from 0 to weight. Returns its
+// index, or -1 when the stack is full of layers that can't be evicted;
+// indices shift as finished layers are dropped, see GLTF_FindAnimLayer.
+int GLTF_PushAnimLayer(AnimInstance* inst, int clip, AnimBlendMode mode, int mask, float weight, float nowSec, float fadeSec) {
+    if (clip < 0 || clip >= (int)gAnims.size()) return -1;
+    if (mask >= (int)gBoneMasks.size()) mask = -1;
+    AnimLayer* L = InsertAnimLayer(inst, inst->layerCount, nowSec);
+    if (!L) return -1;
+    L->clip = clip;
+    L->t0 = nowSec;
+    L->mode = mode;
+    L->mask = mask;
+    L->weightFrom = 0.f;
+    L->weightTo = weight;
+    L->fadeStart = nowSec;
+    L->fadeDur = fadeSec;
+    return (int)(L - inst->layers);
+}
 
-    gActiveAnim = to;
-    gActiveDuration = gAnims[(size_t)to].durationSec;
-    gAnimT0 = gBlendToT0;
+// Topmost layer playing clip with the given mode and mask, or -1.
+int GLTF_FindAnimLayer(const AnimInstance* inst, int clip, AnimBlendMode mode, int mask) {
+    for (int i = inst->layerCount - 1; i >= 0; --i) {
+        const AnimLayer& L = inst->layers[i];
+        if (L.clip == clip && L.mode == mode && L.mask == mask) return i;
+    }
+    return -1;
+}
 
-    gBlendActive = (gBlendDur > 0.f) && (from >= 0) && (to >= 0) && (from != to);
+// Ramps a layer from its current weight; a layer faded to 0 is removed once the fade ends.
+void GLTF_FadeAnimLayer(AnimInstance* inst, int layer, float weight, float nowSec, float fadeSec) {
+    if (layer < 0 || layer >= inst->layerCount) return;
+    AnimLayer& L = inst->layers[layer];
+    L.weightFrom = AnimLayerWeight(L, nowSec);
+    L.weightTo = weight;
+    L.fadeStart = nowSec;
+    L.fadeDur = fadeSec;
 }
 
-void GLTF_UpdateAnimation_Pose(const tinygltf::Model& model, float tSec) {
-    if ((gActiveAnim < 0) || gAnims.empty()) {
-        ComputeGlobalTransforms(model, gGlobalsAnimated);
-        return;
+int GLTF_GetAnimLayerCount(const AnimInstance* inst) { return inst->layerCount; }
+
+// Steady state makes no heap allocations: the pose is scratch from the
+// caller's frame arena, released again before returning.
+void GLTF_UpdateAnimation_Pose(AnimInstance* inst, float tSec, FrameArena* scratch) {
+    const size_t N = (size_t)gHierarchy.count;
+    const size_t mark = frame_arena_mark(scratch);
+    float* cur = (float*)frame_arena_alloc(scratch, N * POSE_STREAMS * sizeof(float));
+    uint8_t* touched = (uint8_t*)frame_arena_alloc(scratch, N);
+    if (!cur || !touched) { frame_arena_rewind(scratch, mark); return; }
+
+    float weight[ANIM_MAX_LAYERS];
+    int first = 0;
+    for (int i = 0; i < inst->layerCount; ++i) {
+        weight[i] = AnimLayerWeight(inst->layers[i], tSec);
+        // A whole-body override at full weight hides everything under it.
+        if (IsBaseLayer(inst->layers[i]) && weight[i] >= 1.f) first = i;
     }
 
-    std::vector<NodeTRS> cur;
+    // The base sample starts from rest itself; otherwise layers blend over rest.
+    const bool direct = inst->layerCount > 0 && IsBaseLayer(inst->layers[first]) && weight[first] >= 1.f;
+    if (!direct) std::memcpy(cur, gHierarchy.rest.data(), N * POSE_STREAMS * sizeof(float));
+    std::memset(touched, 0, N);
+    for (int i = first; i < inst->layerCount; ++i) {
+        const AnimLayer& L = inst->layers[i];
+        if (weight[i] <= 0.f) continue;
+        const GLTFAnimation& A = gAnims[(size_t)L.clip];
+        const float tLocal = AnimLayerLocalTime(L, tSec);
+        if (i == first && direct) {
+            SampleAnimationPose(A, tLocal, L.cursors, cur);
+            std::memcpy(touched, A.slotPaths.data(), N);
+            continue;
+        }
+        const BoneMask* M = (L.mask >= 0) ? &gBoneMasks[(size_t)L.mask] : NULL;
+        if (L.mode == ABM_Additive) AddAdditiveLayer(A, tLocal, L.cursors, M, weight[i], cur, touched);
+        else                        BlendOverrideLayer(A, tLocal, L.cursors, M, weight[i], cur, touched);
+    }
 
-    if (gBlendActive) {
-        float w = (gBlendDur > 1e-6f) ? (tSec - gBlendStart) / gBlendDur : 1.f;
-        if (w < 0.f) w = 0.f; if (w > 1.f) w = 1.f;
+    // Drop layers that are hidden or have faded out.
+    for (int i = 0; i < first; ++i) RemoveAnimLayer(inst, 0);
+    for (int i = inst->layerCount - 1; i >= 0; --i) {
+        const AnimLayer& L = inst->layers[i];
+        if (L.weightTo <= 0.f && tSec >= L.fadeStart + L.fadeDur) RemoveAnimLayer(inst, i);
+    }
 
-        const GLTFAnimation& A0 = gAnims[(size_t)gBlendFrom];
-        const GLTFAnimation& A1 = gAnims[(size_t)gBlendTo];
+    ComputeGlobalTransforms(gHierarchy, cur, inst->globals);
+    BuildSkinPalettes(inst);
+    frame_arena_rewind(scratch, mark);
+}
 
-        float d0 = (A0.durationSec > 0.f) ? A0.durationSec : 0.f;
-        float d1 = (A1.durationSec > 0.f) ? A1.durationSec : 0.f;
+// Instances only share the immutable asset, so each job evaluates a run of
+// them into its worker's scratch arena.
+struct AnimUpdateBatch {
+    AnimInstance* instances;
+    float         tSec;
+    JobSystem*    jobs;
+};
 
-        float t0 = (d0 > 0.f) ? std::fmod(std::max(0.f, tSec - gBlendFromT0), d0) : std::max(0.f, tSec - gBlendFromT0);
-        float t1 = (d1 > 0.f) ? std::fmod(std::max(0.f, tSec - gBlendToT0), d1) : std::max(0.f, tSec - gBlendToT0);
+static void AnimUpdateJob(void* data, int begin, int end, int worker) {
+    AnimUpdateBatch* b = (AnimUpdateBatch*)data;
+    FrameArena* scratch = job_scratch(b->jobs, worker);
+    for (int i = begin; i < end; ++i) GLTF_UpdateAnimation_Pose(&b->instances[i], b->tSec, scratch);
+}
 
-        std::vector<NodeTRS> pose0; SampleAnimationPose(model, A0, t0, pose0);
-        std::vector<NodeTRS> pose1; SampleAnimationPose(model, A1, t1, pose1);
+#define ANIM_UPDATE_GRAIN 4
 
-        cur = gBaseTRS;
-        size_t N = cur.size();
-        for (size_t i = 0; i < N; ++i) {
-            // T
-            cur[i].T[0] = pose0[i].T[0] * (1.f - w) + pose1[i].T[0] * w;
-            cur[i].T[1] = pose0[i].T[1] * (1.f - w) + pose1[i].T[1] * w;
-            cur[i].T[2] = pose0[i].T[2] * (1.f - w) + pose1[i].T[2] * w;
-            // S
-            cur[i].S[0] = pose0[i].S[0] * (1.f - w) + pose1[i].S[0] * w;
-            cur[i].S[1] = pose0[i].S[1] * (1.f - w) + pose1[i].S[1] * w;
-            cur[i].S[2] = pose0[i].S[2] * (1.f - w) + pose1[i].S[2] * w;
-            // R
-            float q[4]; slerpQ(pose0[i].R, pose1[i].R, w, q);
-            cur[i].R[0] = q[0]; cur[i].R[1] = q[1]; cur[i].R[2] = q[2]; cur[i].R[3] = q[3];
-        }
+void GLTF_UpdateAnimations(AnimInstance* instances, int count, float tSec, JobSystem* jobs) {
+    AnimUpdateBatch batch = { instances, tSec, jobs };
+    job_parallel_for(jobs, count, ANIM_UPDATE_GRAIN, AnimUpdateJob, &batch);
+}
 
-        if (w >= 1.f) {
-            gBlendActive = false;
-            gBlendFrom = -1; gBlendTo = -1;
-            gBlendDur = 0.f;
-        }
-    }
-    else {
-        const GLTFAnimation& A = gAnims[(size_t)gActiveAnim];
-        float dur = (A.durationSec > 0.f) ? A.durationSec : 0.f;
-        float tLocal = (dur > 0.f) ? std::fmod(std::max(0.f, tSec - gAnimT0), dur) : std::max(0.f, tSec - gAnimT0);
-        SampleAnimationPose(model, A, tLocal, cur);
-    }
+// The draw's skin palette from the last pose update, d.boneCount column-major
+// mat4s ready to upload; NULL for static draws. Draws of one skin share it.
+const float* GLTF_GetDrawPalette(const AnimInstance* inst, const GLTFDraw& d) {
+    if (!d.skinned || d.skinIndex < 0 || d.boneCount <= 0) return NULL;
+    return inst->palette + (size_t)gSkins[(size_t)d.skinIndex].paletteOffset * 16;
+}
 
-    gGlobalsAnimated.assign(model.nodes.size(), matIdentity());
-    int sceneIndex = model.defaultScene >= 0 ? model.defaultScene : (model.scenes.empty() ? -1 : 0);
-    if (sceneIndex < 0) return;
-
-    struct Item { int node; Mat4 parent; };
-    std::vector<Item> st;
-    for (size_t i = 0; i < model.scenes[sceneIndex].nodes.size(); ++i) {
-        Item it; it.node = model.scenes[sceneIndex].nodes[i]; it.parent = matIdentity(); st.push_back(it);
-    }
-    while (!st.empty()) {
-        Item it = st.back(); st.pop_back();
-        const tinygltf::Node& n = model.nodes[(size_t)it.node];
-        const NodeTRS& B = cur[(size_t)it.node];
-        Mat4 M = matMul(Mat4Translate(B.T[0], B.T[1], B.T[2]),
-            matMul(matFromQuat(B.R[0], B.R[1], B.R[2], B.R[3]),
-                matScale(B.S[0], B.S[1], B.S[2])));
-        Mat4 G = matMul(it.parent, M);
-        gGlobalsAnimated[(size_t)it.node] = G;
-        for (size_t c = 0; c < n.children.size(); ++c) {
-            Item child; child.node = n.children[c]; child.parent = G; st.push_back(child);
-        }
-    }
+// Copy of GLTF_GetDrawPalette; out16 must hold 16 * d.boneCount floats.
+void GLTF_GetBonesForDraw(const AnimInstance* inst, const GLTFDraw& d, float* out16) {
+    const float* palette = GLTF_GetDrawPalette(inst, d);
+    if (palette) std::memcpy(out16, palette, (size_t)d.boneCount * 16 * sizeof(float));
 }
 
-void GLTF_GetBonesForDraw(const GLTFDraw& d, std::vector<float>& out16) {
-    out16.clear();
-    if (!d.skinned || d.skinIndex < 0 || d.boneCount <= 0) return;
-    const GLTFSkin& S = gSkins[(size_t)d.skinIndex];
-    out16.resize((size_t)d.boneCount * 16);
-    for (int j = 0; j < d.boneCount; ++j) {
-        int jointNode = S.joints[(size_t)j];
-        Mat4 B = matMul(gGlobalsAnimated[(size_t)jointNode], S.invBind[(size_t)j]);
-        for (int k = 0; k < 16; ++k) out16[(size_t)j * 16 + k] = B.m[k];
+// Skinned positions of one draw for inst, xyz per vertex of the draw's range
+// in the same space as the shader's output before uModel. Static draws copy
+// their (already baked) positions.
+void GLTF_SkinDrawPositions(const AnimInstance* inst, const GLTFDraw& d, JobSystem* jobs, float* outXYZ) {
+    const float* palette = GLTF_GetDrawPalette(inst, d);
+    if (!palette) {
+        const StaticVertex* verts = gStaticVertices.data() + d.vertexOffset;
+        for (int v = 0; v < d.vertexCount; ++v) std::memcpy(outXYZ + (size_t)v * 3, verts[v].pos, 3 * sizeof(float));
+        return;
     }
+    skin_positions_parallel(jobs, gSkinnedVertices.data() + d.vertexOffset, d.vertexCount, palette, d.boneCount, outXYZ);
 }
 
 // ============================================================
@@ -862,14 +1751,16 @@ int GLTF_FindAnimationIndexContaining(const char* needle) {
     return -1;
 }
 
-void GLTF_SetActiveAnimationByIndex(int idx, float nowSec) {
+// Switches the base clip without a blend; masked and additive layers stay.
+void GLTF_SetActiveAnimationByIndex(AnimInstance* inst, int idx, float nowSec) {
     if (idx < 0 || idx >= (int)gAnims.size()) return;
-    gActiveAnim = idx;
-    gActiveDuration = gAnims[(size_t)idx].durationSec;
-    gAnimT0 = nowSec;
+    SetBaseAnimation(inst, idx, nowSec, nowSec);
 }
 
-int GLTF_GetActiveAnimationIndex() { return gActiveAnim; }
+int GLTF_GetActiveAnimationIndex(const AnimInstance* inst) {
+    int base = AnimBaseLayer(inst);
+    return (base >= 0) ? inst->layers[base].clip : -1;
+}
 
 float GLTF_GetAnimationDuration(int idx) {
     if (idx < 0 || idx >= (int)gAnims.size()) return 0.f;
@@ -885,15 +1776,43 @@ std::string normName(const std::string& s) {
     return r;
 }
 
-bool GLTF_AppendAnimationsFromFile(const char* path) {
-    std::unique_ptr<tinygltf::Model> donor(new tinygltf::Model());
+// Mask of weight 1 over rootJoint and everything under it, e.g. "spine" for
+// the upper body. Returns the gBoneMasks index, or -1 if the joint is missing.
+int GLTF_CreateBoneMask(const char* name, const char* rootJoint) {
+    const FlatHierarchy& H = gHierarchy;
+    const std::string want = normName(rootJoint ? rootJoint : "");
+    int root = -1;
+    for (int i = 0; i < H.count && root < 0; ++i) {
+        if (normName(gModelStatic.nodes[(size_t)H.node[(size_t)i]].name) == want) root = i;
+    }
+    if (root < 0) return -1;
+
+    BoneMask M;
+    M.name = name ? name : "";
+    M.weight.assign((size_t)H.count, 0.f);
+    // Parents precede children, so one pass marks the whole subtree.
+    for (int i = root; i < H.count; ++i) {
+        int p = H.parent[(size_t)i];
+        if (i == root || (p >= 0 && M.weight[(size_t)p] > 0.f)) {
+            M.weight[(size_t)i] = 1.f;
+            M.slots.push_back((uint16_t)i);
+        }
+    }
+    gBoneMasks.push_back(M);
+    return (int)gBoneMasks.size() - 1;
+}
+
+// Decodes a file's clips, retargeted onto the loaded skeleton, without
+// compressing or registering them.
+bool GLTF_DecodeAnimationsFromFile(const char* path, std::vector<GLTFAnimation>& out) {
+    tinygltf::Model donor;
     tinygltf::TinyGLTF loader;
     std::string err, warn;
 
     bool ok = false;
     std::string p(path);
-    if (EndsWithNoCase(p, ".glb")) ok = loader.LoadBinaryFromFile(donor.get(), &err, &warn, p);
-    else                           ok = loader.LoadASCIIFromFile(donor.get(), &err, &warn, p);
+    if (EndsWithNoCase(p, ".glb")) ok = loader.LoadBinaryFromFile(&donor, &err, &warn, p);
+    else                           ok = loader.LoadASCIIFromFile(&donor, &err, &warn, p);
     if (!ok) return false;
 
     std::unordered_map<std::string, int> baseByName;
@@ -902,52 +1821,27 @@ bool GLTF_AppendAnimationsFromFile(const char* path) {
         if (!n.name.empty()) baseByName[normName(n.name)] = i;
     }
 
-    int appended = 0;
-    for (size_t ai = 0; ai < donor->animations.size(); ++ai) {
-        const tinygltf::Animation& a = donor->animations[ai];
-        GLTFAnimation A; A.name = a.name;
-        A.samplers.resize(a.samplers.size());
-        for (size_t si = 0; si < a.samplers.size(); ++si) {
-            const tinygltf::AnimationSampler& s = a.samplers[si];
-            A.samplers[si].inputAcc = s.input;
-            A.samplers[si].outputAcc = s.output;
-            A.samplers[si].interp = s.interpolation.empty() ? "LINEAR" : s.interpolation;
-            if (s.output >= 0) {
-                const tinygltf::Accessor& acc = donor->accessors[(size_t)s.output];
-                A.samplers[si].comps = tinygltf::GetNumComponentsInType(acc.type);
-            }
-            float mt = AccessorMaxTime(*donor, s.input);
-            if (mt > A.durationSec) A.durationSec = mt;
-            A.samplers[si].srcModel = donor.get();
-        }
-
-        for (size_t ci = 0; ci < a.channels.size(); ++ci) {
-            const tinygltf::AnimationChannel& c = a.channels[ci];
-            int donorNode = c.target_node;
-            if (donorNode < 0 || donorNode >= (int)donor->nodes.size()) continue;
-            std::string dn = normName(donor->nodes[(size_t)donorNode].name);
-            if (dn.empty()) continue;
-
-            int baseNode = -1;
-            std::unordered_map<std::string, int>::const_iterator it = baseByName.find(dn);
-            if (it != baseByName.end()) baseNode = it->second;
-            if (baseNode < 0) continue;
-
-            AnimChannel C;
-            C.sampler = c.sampler;
-            C.targetNode = baseNode;
-            if (c.target_path == "translation") C.path = AP_Translation;
-            else if (c.target_path == "rotation") C.path = AP_Rotation;
-            else C.path = AP_Scale;
-            A.channels.push_back(C);
-        }
-
-        if (!A.channels.empty()) { gAnims.push_back(A); appended++; }
+    // Retarget donor nodes onto the base skeleton's slots by normalized name.
+    std::vector<int> nodeMap(donor.nodes.size(), -1);
+    for (size_t i = 0; i < donor.nodes.size(); ++i) {
+        std::string dn = normName(donor.nodes[i].name);
+        if (dn.empty()) continue;
+        std::unordered_map<std::string, int>::const_iterator it = baseByName.find(dn);
+        if (it != baseByName.end()) nodeMap[i] = gHierarchy.slotOf[(size_t)it->second];
     }
 
-    if (appended > 0) {
-        gAnimSources.emplace_back(std::move(donor));
-        return true;
+    // Keys are decoded into each clip's own store, so the donor can go out of scope.
+    for (size_t ai = 0; ai < donor.animations.size(); ++ai) {
+        GLTFAnimation A;
+        DecodeAnimation(donor, donor.animations[ai], nodeMap, A);
+        if (!A.channels.empty()) out.push_back(A);
     }
-    return false;
-}
\ No newline at end of file
+    return !out.empty();
+}
+
+bool GLTF_AppendAnimationsFromFile(const char* path) {
+    std::vector<GLTFAnimation> clips;
+    if (!GLTF_DecodeAnimationsFromFile(path, clips)) return false;
+    for (size_t i = 0; i < clips.size(); ++i) AddAnimation(clips[i]);
+    return true;
+}
@@ -0,0 +1,322 @@
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// ============================================================
+// Work-stealing job system. Worker 0 is the thread that calls
+// job_system_init and later job_wait; workers 1..N-1 are owned threads.
+// Each worker has its own deque: the owner pushes and pops at the bottom
+// (LIFO, cache-warm), idle workers steal from the top (FIFO, big chunks).
+// Queues are fixed rings, so submitting never touches the heap.
+
+#define JOB_MAX_WORKERS 16
+#define JOB_QUEUE_CAPACITY 1024   // per worker, power of two
+#define JOB_MAX_CONTINUATIONS 8
+#define JOB_SCRATCH_SIZE (32 * 1024)   // per worker, until job_reserve_scratch asks for more
+
+typedef void JobFunc(void* data, int begin, int end, int worker);
+
+struct JobCounter;
+
+struct Job
+{
+    JobFunc*    fn;
+    void*       data;
+    int         begin;
+    int         end;
+    JobCounter* counter;   // released when the job finishes, may be NULL
+};
+
+// Dependency counter: one count per outstanding job. Jobs queued with
+// job_submit_after start once it drops to zero. Only reuse or destroy a
+// counter after job_wait on it has returned; no worker touches it then.
+struct JobCounter
+{
+    std::atomic<int> pending;
+    std::mutex       lock;   // guards continuations and the final decrement
+    int              continuationCount;
+    Job              continuations[JOB_MAX_CONTINUATIONS];
+    JobCounter() : pending(0), continuationCount(0) {}
+};
+
+struct JobDeque
+{
+    std::mutex lock;
+    uint32_t   top;      // thieves take here
+    uint32_t   bottom;   // owner pushes and pops here
+    Job        jobs[JOB_QUEUE_CAPACITY];
+    JobDeque() : top(0), bottom(0) {}
+};
+
+struct JobSystem
+{
+    int                     workerCount;   // including worker 0
+    std::thread             threads[JOB_MAX_WORKERS];
+    JobDeque                queues[JOB_MAX_WORKERS];
+    FrameArena              scratch[JOB_MAX_WORKERS];   // per-worker frame scratch
+    MemoryArena*            backing;
+    size_t                  scratchSize;   // per worker, kept across shutdown and init
+    std::atomic<int>        queued;
+    std::atomic<bool>       running;
+    std::mutex              sleepLock;
+    std::condition_variable wake;
+    JobSystem() : workerCount(0), backing(NULL), scratchSize(JOB_SCRATCH_SIZE), queued(0), running(false) {}
+};
+
+JobSystem gJobs;
+
+// Worker index of the calling thread; threads outside the system act as worker 0.
+thread_local int tJobWorker = 0;
+
+static bool job_push(JobSystem* js, int worker, const Job& job)
+{
+    JobDeque& q = js->queues[worker];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.bottom - q.top >= JOB_QUEUE_CAPACITY)
+        return false;
+    q.jobs[q.bottom & (JOB_QUEUE_CAPACITY - 1)] = job;
+    ++q.bottom;
+    return true;
+}
+
+static bool job_pop(JobSystem* js, int worker, Job* out)
+{
+    JobDeque& q = js->queues[worker];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.bottom == q.top)
+        return false;
+    --q.bottom;
+    *out = q.jobs[q.bottom & (JOB_QUEUE_CAPACITY - 1)];
+    return true;
+}
+
+static bool job_steal(JobSystem* js, int thief, Job* out)
+{
+    for (int i = 1; i < js->workerCount; ++i)
+    {
+        JobDeque& q = js->queues[(thief + i) % js->workerCount];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.bottom == q.top)
+            continue;
+        *out = q.jobs[q.top & (JOB_QUEUE_CAPACITY - 1)];
+        ++q.top;
+        return true;
+    }
+    return false;
+}
+
+static bool job_find(JobSystem* js, int worker, Job* out)
+{
+    if (js->queued.load(std::memory_order_acquire) == 0)
+        return false;
+    if (job_pop(js, worker, out) || job_steal(js, worker, out))
+    {
+        js->queued.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+    return false;
+}
+
+static void job_run(JobSystem* js, const Job& job, int worker);
+
+static void job_enqueue(JobSystem* js, const Job& job)
+{
+    // Count before publishing so a thief never sees the job without it.
+    js->queued.fetch_add(1, std::memory_order_acq_rel);
+    if (js->workerCount <= 1 || !job_push(js, tJobWorker, job))
+    {
+        // Single-threaded or queue full: run inline.
+        js->queued.fetch_sub(1, std::memory_order_acq_rel);
+        job_run(js, job, tJobWorker);
+        return;
+    }
+    {
+        // Taking the lock orders this wake-up against a worker about to sleep.
+        std::lock_guard<std::mutex> guard(js->sleepLock);
+    }
+    js->wake.notify_one();
+}
+
+// The decrement happens under counter->lock and the counter isn't touched
+// after the unlock, so job_wait taking the lock once after pending reaches
+// zero knows the last release is done with it.
+static void job_counter_release(JobSystem* js, JobCounter* counter)
+{
+    Job ready[JOB_MAX_CONTINUATIONS];
+    int readyCount = 0;
+    {
+        std::lock_guard<std::mutex> guard(counter->lock);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        readyCount = counter->continuationCount;
+        for (int i = 0; i < readyCount; ++i)
+            ready[i] = counter->continuations[i];
+        counter->continuationCount = 0;
+    }
+    for (int i = 0; i < readyCount; ++i)
+        job_enqueue(js, ready[i]);
+}
+
+static void job_run(JobSystem* js, const Job& job, int worker)
+{
+    job.fn(job.data, job.begin, job.end, worker);
+    if (job.counter)
+        job_counter_release(js, job.counter);
+}
+
+static void job_worker_main(JobSystem* js, int worker)
+{
+    tJobWorker = worker;
+    Job job;
+    while (js->running.load(std::memory_order_acquire))
+    {
+        if (job_find(js, worker, &job))
+        {
+            job_run(js, job, worker);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(js->sleepLock);
+        while (js->queued.load(std::memory_order_acquire) == 0 && js->running.load(std::memory_order_acquire))
+            js->wake.wait(lock);
+    }
+}
+
+// workerCount <= 0 picks one worker per hardware thread.
+void job_system_init(JobSystem* js, int workerCount, MemoryArena* backing)
+{
+    if (workerCount <= 0)
+        workerCount = (int)std::thread::hardware_concurrency();
+    if (workerCount < 1)
+        workerCount = 1;
+    if (workerCount > JOB_MAX_WORKERS)
+        workerCount = JOB_MAX_WORKERS;
+
+    js->workerCount = workerCount;
+    js->backing = backing;
+    js->queued.store(0);
+    js->running.store(true);
+    for (int w = 0; w < workerCount; ++w)
+    {
+        js->queues[w].top = js->queues[w].bottom = 0;
+        frame_arena_init(&js->scratch[w], backing, js->scratchSize);
+    }
+    for (int w = 1; w < workerCount; ++w)
+        js->threads[w] = std::thread(job_worker_main, js, w);
+}
+
+void job_system_shutdown(JobSystem* js)
+{
+    {
+        std::lock_guard<std::mutex> guard(js->sleepLock);
+        js->running.store(false);
+    }
+    js->wake.notify_all();
+    for (int w = 1; w < js->workerCount; ++w)
+    {
+        if (js->threads[w].joinable())
+            js->threads[w].join();
+    }
+    for (int w = 0; w < js->workerCount; ++w)
+        frame_arena_release(&js->scratch[w], js->backing);
+    js->workerCount = 0;
+}
+
+void job_system_reset_scratch(JobSystem* js)
+{
+    for (int w = 0; w < js->workerCount; ++w)
+        frame_arena_reset(&js->scratch[w]);
+}
+
+FrameArena* job_scratch(JobSystem* js, int worker)
+{
+    return &js->scratch[worker];
+}
+
+// Grows every worker's scratch to at least bytes; call with no jobs in
+// flight, e.g. after loading the data jobs will work on. False when the
+// backing arena can't supply it, leaving the old scratch in place.
+bool job_reserve_scratch(JobSystem* js, size_t bytes)
+{
+    if (bytes <= js->scratchSize)
+        return true;
+    for (int w = 0; w < js->workerCount; ++w)
+    {
+        FrameArena grown;
+        frame_arena_init(&grown, js->backing, bytes);
+        if (!grown.base)
+        {
+            fprintf(stderr, "[jobs] no room for %zu bytes of scratch per worker\n", bytes);
+            return false;
+        }
+        frame_arena_release(&js->scratch[w], js->backing);
+        js->scratch[w] = grown;
+    }
+    js->scratchSize = bytes;
+    return true;
+}
+
+void job_submit(JobSystem* js, JobFunc* fn, void* data, int begin, int end, JobCounter* counter)
+{
+    Job job = { fn, data, begin, end, counter };
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_acq_rel);
+    job_enqueue(js, job);
+}
+
+// The waiting thread keeps executing jobs until the counter drains.
+void job_wait(JobSystem* js, JobCounter* counter)
+{
+    const int worker = tJobWorker;
+    Job job;
+    while (counter->pending.load(std::memory_order_acquire) > 0)
+    {
+        if (job_find(js, worker, &job))
+            job_run(js, job, worker);
+        else
+            std::this_thread::yield();
+    }
+    // Wait out the release that took pending to zero: it may still hold the lock.
+    std::lock_guard<std::mutex> guard(counter->lock);
+}
+
+// Queues the job to start once dependency reaches zero.
+void job_submit_after(JobSystem* js, JobCounter* dependency, JobFunc* fn, void* data, int begin, int end, JobCounter* counter)
+{
+    Job job = { fn, data, begin, end, counter };
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_acq_rel);
+    {
+        std::lock_guard<std::mutex> guard(dependency->lock);
+        if (dependency->pending.load(std::memory_order_acquire) > 0 &&
+            dependency->continuationCount < JOB_MAX_CONTINUATIONS)
+        {
+            dependency->continuations[dependency->continuationCount++] = job;
+            return;
+        }
+    }
+    // Already satisfied, or no room to defer: wait it out here.
+    job_wait(js, dependency);
+    job_enqueue(js, job);
+}
+
+// Splits [0, count) into chunks of at most grain items and waits for all of them.
+void job_parallel_for(JobSystem* js, int count, int grain, JobFunc* fn, void* data)
+{
+    if (count <= 0)
+        return;
+    if (grain < 1)
+        grain = 1;
+    if (js->workerCount <= 1 || count <= grain)
+    {
+        fn(data, 0, count, tJobWorker);
+        return;
+    }
+    JobCounter counter;
+    for (int begin = 0; begin < count; begin += grain)
+    {
+        int end = begin + grain < count ? begin + grain : count;
+        job_submit(js, fn, data, begin, end, &counter);
+    }
+    job_wait(js, &counter);
+}
@@ -3,18 +3,33 @@
 
 #include <cmath>
 
+// SIMD kernels are picked at compile time: AVX2 when the compiler targets it
+// (/arch:AVX2, -mavx2), else SSE2 on x86/x64, else scalar. Define
+// MATH_FORCE_SCALAR to opt out. All paths keep the same operation order, so
+// they produce identical results.
+#if !defined(MATH_FORCE_SCALAR) && defined(__AVX2__)
+#define MATH_SIMD_AVX2 1
+#define MATH_SIMD_SSE 1
+#include <immintrin.h>
+#elif !defined(MATH_FORCE_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MATH_SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Column-major 4x4, as uploaded to the UBOs: element (row r, col c) is m[c * 4 + r].
 struct Mat4 { float m[16]; };
 
+// Affine transform with an implicit (0,0,0,1) last row, stored as three
+// rows of four: row r is (m[r*4+0], m[r*4+1], m[r*4+2], translation r).
+struct Affine3x4 { float m[12]; };
+
 Mat4 matIdentity() {
     Mat4 r{};
-    for (int i = 0; i < 16; i++) {
-        r.m[i] = 0.0f;
-        r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
-    }
+    r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
     return r;
 }
 
-Mat4 matMul(const Mat4& A, const Mat4& B) {
+Mat4 matMulScalar(const Mat4& A, const Mat4& B) {
     Mat4 R; 
     for (int c = 0; c < 4; c++) {
         for (int r = 0; r < 4; r++) {
@@ -24,6 +39,44 @@ Mat4 matMul(const Mat4& A, const Mat4& B) {
     return R;
 }
 
+Mat4 matMul(const Mat4& A, const Mat4& B) {
+#if defined(MATH_SIMD_AVX2)
+    // Two result columns per iteration: broadcast A's columns to both lanes,
+    // splat B's column entries within each lane.
+    Mat4 R;
+    const __m256 a0 = _mm256_broadcast_ps((const __m128*)(A.m + 0));
+    const __m256 a1 = _mm256_broadcast_ps((const __m128*)(A.m + 4));
+    const __m256 a2 = _mm256_broadcast_ps((const __m128*)(A.m + 8));
+    const __m256 a3 = _mm256_broadcast_ps((const __m128*)(A.m + 12));
+    for (int c = 0; c < 4; c += 2) {
+        const __m256 b = _mm256_loadu_ps(B.m + c * 4);
+        __m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(b, 0x00));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_permute_ps(b, 0x55)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_permute_ps(b, 0xAA)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_permute_ps(b, 0xFF)));
+        _mm256_storeu_ps(R.m + c * 4, r);
+    }
+    return R;
+#elif defined(MATH_SIMD_SSE)
+    Mat4 R;
+    const __m128 a0 = _mm_loadu_ps(A.m + 0);
+    const __m128 a1 = _mm_loadu_ps(A.m + 4);
+    const __m128 a2 = _mm_loadu_ps(A.m + 8);
+    const __m128 a3 = _mm_loadu_ps(A.m + 12);
+    for (int c = 0; c < 4; ++c) {
+        const float* b = B.m + c * 4;
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(b[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b[3])));
+        _mm_storeu_ps(R.m + c * 4, r);
+    }
+    return R;
+#else
+    return matMulScalar(A, B);
+#endif
+}
+
 Mat4 matPerspective(float fovyRad, float aspect, float zNear, float zFar) {
     Mat4 M{};
     const float f = 1.0f / std::tan(0.5f * fovyRad);
@@ -109,8 +162,95 @@ Mat4 matFromQuat(float x, float y, float z, float w) {
     return R;
 }
 
+// T * R * S written out directly: rotation columns scaled, translation in column 3.
 Mat4 matTRS(float tx, float ty, float tz, float qx, float qy, float qz, float qw, float sx, float sy, float sz) {
-    return matMul(Mat4Translate(tx, ty, tz), matMul(matFromQuat(qx, qy, qz, qw), matScale(sx, sy, sz)));
+    const float xx = qx * qx, yy = qy * qy, zz = qz * qz;
+    const float xy = qx * qy, xz = qx * qz, yz = qy * qz;
+    const float wx = qw * qx, wy = qw * qy, wz = qw * qz;
+    Mat4 M;
+    M.m[0] = (1 - 2 * (yy + zz)) * sx; M.m[1] = (2 * (xy + wz)) * sx;     M.m[2] = (2 * (xz - wy)) * sx;      M.m[3] = 0.f;
+    M.m[4] = (2 * (xy - wz)) * sy;     M.m[5] = (1 - 2 * (xx + zz)) * sy; M.m[6] = (2 * (yz + wx)) * sy;      M.m[7] = 0.f;
+    M.m[8] = (2 * (xz + wy)) * sz;     M.m[9] = (2 * (yz - wx)) * sz;     M.m[10] = (1 - 2 * (xx + yy)) * sz; M.m[11] = 0.f;
+    M.m[12] = tx; M.m[13] = ty; M.m[14] = tz; M.m[15] = 1.f;
+    return M;
+}
+
+// ---------------- Affine3x4 ----------------
+Affine3x4 affineIdentity() {
+    Affine3x4 A{};
+    A.m[0] = A.m[5] = A.m[10] = 1.0f;
+    return A;
+}
+
+Affine3x4 affineTRS(float tx, float ty, float tz, float qx, float qy, float qz, float qw, float sx, float sy, float sz) {
+    const float xx = qx * qx, yy = qy * qy, zz = qz * qz;
+    const float xy = qx * qy, xz = qx * qz, yz = qy * qz;
+    const float wx = qw * qx, wy = qw * qy, wz = qw * qz;
+    Affine3x4 A;
+    A.m[0] = (1 - 2 * (yy + zz)) * sx; A.m[1] = (2 * (xy - wz)) * sy;     A.m[2] = (2 * (xz + wy)) * sz;      A.m[3] = tx;
+    A.m[4] = (2 * (xy + wz)) * sx;     A.m[5] = (1 - 2 * (xx + zz)) * sy; A.m[6] = (2 * (yz - wx)) * sz;      A.m[7] = ty;
+    A.m[8] = (2 * (xz - wy)) * sx;     A.m[9] = (2 * (yz + wx)) * sy;     A.m[10] = (1 - 2 * (xx + yy)) * sz; A.m[11] = tz;
+    return A;
+}
+
+Affine3x4 affineMulScalar(const Affine3x4& A, const Affine3x4& B) {
+    Affine3x4 R;
+    for (int r = 0; r < 3; ++r) {
+        const float* a = A.m + r * 4;
+        for (int c = 0; c < 4; ++c) {
+            R.m[r * 4 + c] = a[0] * B.m[0 * 4 + c] + a[1] * B.m[1 * 4 + c] + a[2] * B.m[2 * 4 + c] + (c == 3 ? a[3] : 0.f);
+        }
+    }
+    return R;
+}
+
+Affine3x4 affineMul(const Affine3x4& A, const Affine3x4& B) {
+#if defined(MATH_SIMD_SSE)
+    Affine3x4 R;
+    const __m128 b0 = _mm_loadu_ps(B.m + 0);
+    const __m128 b1 = _mm_loadu_ps(B.m + 4);
+    const __m128 b2 = _mm_loadu_ps(B.m + 8);
+    for (int r = 0; r < 3; ++r) {
+        const float* a = A.m + r * 4;
+        __m128 v = _mm_mul_ps(_mm_set1_ps(a[0]), b0);
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(a[1]), b1));
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(a[2]), b2));
+        v = _mm_add_ps(v, _mm_setr_ps(0.f, 0.f, 0.f, a[3]));
+        _mm_storeu_ps(R.m + r * 4, v);
+    }
+    return R;
+#else
+    return affineMulScalar(A, B);
+#endif
+}
+
+// Column-major 4x4 for UBO uploads.
+Mat4 affineToMat4(const Affine3x4& A) {
+    Mat4 M;
+    for (int c = 0; c < 4; ++c) {
+        M.m[c * 4 + 0] = A.m[0 * 4 + c];
+        M.m[c * 4 + 1] = A.m[1 * 4 + c];
+        M.m[c * 4 + 2] = A.m[2 * 4 + c];
+        M.m[c * 4 + 3] = (c == 3) ? 1.f : 0.f;
+    }
+    return M;
+}
+
+// Drops the projective row; only valid for affine matrices.
+Affine3x4 affineFromMat4(const Mat4& M) {
+    Affine3x4 A;
+    for (int c = 0; c < 4; ++c) {
+        A.m[0 * 4 + c] = M.m[c * 4 + 0];
+        A.m[1 * 4 + c] = M.m[c * 4 + 1];
+        A.m[2 * 4 + c] = M.m[c * 4 + 2];
+    }
+    return A;
+}
+
+void xformPointAffine(const Affine3x4& A, float x, float y, float z, float& ox, float& oy, float& oz) {
+    ox = A.m[0] * x + A.m[1] * y + A.m[2] * z + A.m[3];
+    oy = A.m[4] * x + A.m[5] * y + A.m[6] * z + A.m[7];
+    oz = A.m[8] * x + A.m[9] * y + A.m[10] * z + A.m[11];
 }
 
 void xformPoint(const Mat4& M, float x, float y, float z, float& ox, float& oy, float& oz) {
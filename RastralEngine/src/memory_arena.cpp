@@ -1,11 +1,13 @@
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
-#define GAME_ARENA_SIZE (1024 * 1024)
+#define GAME_ARENA_SIZE (16 * 1024 * 1024)
+#define FRAME_ARENA_SIZE (1024 * 1024)
 #define HEADER_SIZE (sizeof(size_t))
 
 typedef struct BlockHeader
@@ -21,7 +23,18 @@ typedef struct MemoryArena
     BlockHeader* freeList;
 } MemoryArena;
 
+// Bump allocator for data that only lives for one frame. Its block is carved
+// out of a MemoryArena once; frame_arena_reset releases everything at once.
+typedef struct FrameArena
+{
+    size_t size;
+    size_t used;
+    size_t highWater;
+    unsigned char* base;
+} FrameArena;
+
 MemoryArena engineMemArena;
+FrameArena frameScratchArena;
 
 size_t align8(size_t size)
 {
@@ -175,4 +188,103 @@ void* arena_realloc(MemoryArena* arena, void* ptr, size_t new_size)
 
     arena_free(arena, ptr);
     return newPtr;
-}
\ No newline at end of file
+}
+
+void frame_arena_init(FrameArena* frame, MemoryArena* backing, size_t size)
+{
+    if (!frame)
+        return;
+    frame->base = (unsigned char*)arena_alloc(backing, size);
+    frame->size = frame->base ? size : 0;
+    frame->used = 0;
+    frame->highWater = 0;
+}
+
+void frame_arena_release(FrameArena* frame, MemoryArena* backing)
+{
+    if (!frame)
+        return;
+    arena_free(backing, frame->base);
+    frame->base = NULL;
+    frame->size = frame->used = 0;
+}
+
+void frame_arena_reset(FrameArena* frame)
+{
+    if (!frame)
+        return;
+    frame->used = 0;
+}
+
+// Returns 16-byte aligned memory that stays valid until the next reset.
+// base is only 8-aligned (an arena block plus its header), so the address
+// is rounded, not the offset.
+void* frame_arena_alloc(FrameArena* frame, size_t size)
+{
+    if (!frame || !frame->base)
+        return NULL;
+    const uintptr_t at = ((uintptr_t)(frame->base + frame->used) + 15U) & ~(uintptr_t)15U;
+    size_t offset = (size_t)(at - (uintptr_t)frame->base);
+    if (offset + size > frame->size)
+    {
+        fprintf(stderr, "FrameArena out of memory (%zu of %zu bytes used, %zu requested)\n", frame->used, frame->size, size);
+        return NULL;
+    }
+    frame->used = offset + size;
+    if (frame->used > frame->highWater)
+        frame->highWater = frame->used;
+    return frame->base + offset;
+}
+
+// Mark/rewind releases scratch taken after the mark, for temporaries that
+// don't need to live until the end of the frame.
+size_t frame_arena_mark(FrameArena* frame)
+{
+    return frame ? frame->used : 0;
+}
+
+void frame_arena_rewind(FrameArena* frame, size_t mark)
+{
+    if (!frame || mark > frame->used)
+        return;
+    frame->used = mark;
+}
+
+// Debug heap counter. Debug builds route global operator new through a
+// counter so the render loop can check that a steady-state frame allocates
+// nothing. Release builds report zero.
+#if defined(_DEBUG) || defined(RASTRAL_COUNT_HEAP_ALLOCS)
+#include <atomic>
+#include <new>
+
+std::atomic<unsigned long long> gDebugHeapAllocs(0);
+
+void* operator new(size_t size)
+{
+    gDebugHeapAllocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+unsigned long long debug_heap_alloc_count()
+{
+    return gDebugHeapAllocs.load(std::memory_order_relaxed);
+}
+#else
+unsigned long long debug_heap_alloc_count()
+{
+    return 0;
+}
+#endif
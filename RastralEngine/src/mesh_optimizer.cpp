@@ -0,0 +1,696 @@
+#include <cstddef>
+#include <cstdint>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// ============================================================
+// Import-time index and vertex ordering for indexed triangle lists:
+//   1. mesh_opt_vertex_cache: Forsyth's linear-speed vertex cache
+//      optimisation, greedy triangle order scored against an LRU cache.
+//   2. mesh_opt_overdraw: splits that order into clusters at points where
+//      the cache has little to lose, then draws outward-facing clusters
+//      first so early-z rejects more of what's behind them (Sander et al.,
+//      "Fast triangle reordering for vertex locality and reduced overdraw").
+//   3. mesh_opt_vertex_fetch_remap: renumbers vertices in first-use order so
+//      vertex fetch walks the buffer forward.
+// mesh_opt_analyze reports ACMR (cache misses per triangle) and ATVR (misses
+// per referenced vertex) against a FIFO cache, 1.0 being the ATVR ideal, and
+// overdraw (fragments passing a LESS depth test per covered pixel) from a
+// small software rasterizer looking along the six axis directions.
+
+#define MESH_OPT_CACHE_SIZE 32          // LRU the Forsyth scores are tuned for
+#define MESH_OPT_FIFO_SIZE 16           // cache the stats are measured against
+#define MESH_OPT_OVERDRAW_THRESHOLD 1.0f    // cluster ACMR allowed over the whole mesh's
+#define MESH_OPT_MIN_CLUSTER 32         // triangles
+#define MESH_OPT_RASTER_SIZE 128        // overdraw estimate resolution
+
+struct MeshOptStats
+{
+    float  acmr;
+    float  atvr;
+    float  overdraw;   // 0 without positions
+    size_t misses;
+};
+
+// Misses of each triangle in order against a FIFO cache, summed into stats.
+static size_t mesh_opt_fifo_misses(const uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize, uint8_t* triMisses)
+{
+    std::vector<uint32_t> stamp(vertexCount, 0);   // time the vertex entered the cache, 0 = never
+    uint32_t time = (uint32_t)cacheSize + 1;
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        uint8_t m = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint32_t v = indices[i + k];
+            if (stamp[v] == 0 || time - stamp[v] > (uint32_t)cacheSize)
+            {
+                stamp[v] = time++;
+                ++m;
+            }
+        }
+        if (triMisses) triMisses[i / 3] = m;
+        misses += m;
+    }
+    return misses;
+}
+
+// Rasterizes with pixel-centre coverage, no culling (the mesh pass draws
+// both faces), along +-X, +-Y, +-Z over the mesh's bounds.
+static float mesh_opt_overdraw_estimate(const uint32_t* indices, size_t indexCount, const float* positions, size_t stride, size_t vertexCount)
+{
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            lo[k] = std::min(lo[k], positions[v * stride + k]);
+            hi[k] = std::max(hi[k], positions[v * stride + k]);
+        }
+    }
+    const float extent = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+    if (!(extent > 0.f)) return 0.f;
+    const float scale = (float)MESH_OPT_RASTER_SIZE / extent;
+
+    std::vector<float> depth((size_t)MESH_OPT_RASTER_SIZE * MESH_OPT_RASTER_SIZE);
+    size_t shaded = 0, covered = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const int ax = (axis + 1) % 3, ay = (axis + 2) % 3;
+        for (int dir = 0; dir < 2; ++dir)
+        {
+            std::fill(depth.begin(), depth.end(), FLT_MAX);
+            for (size_t i = 0; i + 2 < indexCount; i += 3)
+            {
+                float x[3], y[3], z[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    const float* p = positions + indices[i + k] * stride;
+                    x[k] = (p[ax] - lo[ax]) * scale;
+                    y[k] = (p[ay] - lo[ay]) * scale;
+                    z[k] = dir ? hi[axis] - p[axis] : p[axis] - lo[axis];
+                }
+                const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+                if (area == 0.f) continue;
+                const int x0 = std::max(0, (int)std::floor(std::min(std::min(x[0], x[1]), x[2])));
+                const int x1 = std::min(MESH_OPT_RASTER_SIZE - 1, (int)std::ceil(std::max(std::max(x[0], x[1]), x[2])));
+                const int y0 = std::max(0, (int)std::floor(std::min(std::min(y[0], y[1]), y[2])));
+                const int y1 = std::min(MESH_OPT_RASTER_SIZE - 1, (int)std::ceil(std::max(std::max(y[0], y[1]), y[2])));
+                const float inv = 1.f / area;
+                for (int py = y0; py <= y1; ++py)
+                {
+                    for (int px = x0; px <= x1; ++px)
+                    {
+                        const float cx = (float)px + 0.5f, cy = (float)py + 0.5f;
+                        const float w0 = ((x[1] - cx) * (y[2] - cy) - (x[2] - cx) * (y[1] - cy)) * inv;
+                        const float w1 = ((x[2] - cx) * (y[0] - cy) - (x[0] - cx) * (y[2] - cy)) * inv;
+                        const float w2 = 1.f - w0 - w1;
+                        if (w0 < 0.f || w1 < 0.f || w2 < 0.f) continue;
+                        const float d = w0 * z[0] + w1 * z[1] + w2 * z[2];
+                        float& dst = depth[(size_t)py * MESH_OPT_RASTER_SIZE + px];
+                        if (dst == FLT_MAX) ++covered;
+                        if (d < dst) { dst = d; ++shaded; }
+                    }
+                }
+            }
+        }
+    }
+    return covered ? (float)shaded / (float)covered : 0.f;
+}
+
+// positions (xyz, stride in floats) may be NULL to skip the overdraw estimate.
+MeshOptStats mesh_opt_analyze(const uint32_t* indices, size_t indexCount, size_t vertexCount, const float* positions, size_t stride)
+{
+    MeshOptStats s = { 0.f, 0.f, 0.f, 0 };
+    if (indexCount < 3) return s;
+    s.misses = mesh_opt_fifo_misses(indices, indexCount, vertexCount, MESH_OPT_FIFO_SIZE, NULL);
+
+    std::vector<uint8_t> used(vertexCount, 0);
+    size_t referenced = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        if (!used[indices[i]]) { used[indices[i]] = 1; ++referenced; }
+    }
+    s.acmr = (float)s.misses / (float)(indexCount / 3);
+    s.atvr = referenced ? (float)s.misses / (float)referenced : 0.f;
+    if (positions) s.overdraw = mesh_opt_overdraw_estimate(indices, indexCount, positions, stride, vertexCount);
+    return s;
+}
+
+#define MESH_OPT_VALENCE_TABLE 32
+
+struct MeshOptScoreTables
+{
+    float cache[MESH_OPT_CACHE_SIZE];
+    float valence[MESH_OPT_VALENCE_TABLE];
+};
+
+static void mesh_opt_init_scores(MeshOptScoreTables* t)
+{
+    for (int i = 0; i < MESH_OPT_CACHE_SIZE; ++i)
+    {
+        // The last triangle's vertices get a fixed score so they aren't favoured unduly.
+        t->cache[i] = (i < 3) ? 0.75f : std::pow(1.f - (float)(i - 3) / (float)(MESH_OPT_CACHE_SIZE - 3), 1.5f);
+    }
+    t->valence[0] = 0.f;
+    for (int i = 1; i < MESH_OPT_VALENCE_TABLE; ++i) t->valence[i] = 2.f / std::sqrt((float)i);
+}
+
+static float mesh_opt_vertex_score(const MeshOptScoreTables& t, int cachePos, uint32_t remaining)
+{
+    if (remaining == 0) return -1.f;
+    const float score = (cachePos >= 0) ? t.cache[cachePos] : 0.f;
+    // Boost vertices with few triangles left.
+    return score + ((remaining < MESH_OPT_VALENCE_TABLE) ? t.valence[remaining] : 2.f / std::sqrt((float)remaining));
+}
+
+void mesh_opt_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    const size_t triCount = indexCount / 3;
+    if (triCount == 0) return;
+
+    // Triangles of each vertex; the live ones are the first remaining[v].
+    std::vector<uint32_t> remaining(vertexCount, 0), adjOffset(vertexCount + 1, 0), adj(indexCount);
+    for (size_t i = 0; i < indexCount; ++i) ++remaining[indices[i]];
+    for (size_t v = 0; v < vertexCount; ++v) adjOffset[v + 1] = adjOffset[v] + remaining[v];
+    {
+        std::vector<uint32_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i) adj[fill[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    MeshOptScoreTables tables;
+    mesh_opt_init_scores(&tables);
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vScore(vertexCount), tScore(triCount, 0.f);
+    std::vector<uint8_t> emitted(triCount, 0);
+    for (size_t v = 0; v < vertexCount; ++v) vScore[v] = mesh_opt_vertex_score(tables, -1, remaining[v]);
+    for (size_t t = 0; t < triCount; ++t)
+        tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+
+    std::vector<uint32_t> out(indexCount);
+    uint32_t cache[MESH_OPT_CACHE_SIZE + 3], next[MESH_OPT_CACHE_SIZE + 3];
+    int cacheCount = 0;
+
+    size_t best = 0;
+    for (size_t t = 1; t < triCount; ++t) if (tScore[t] > tScore[best]) best = t;
+    size_t cursor = 0;
+
+    for (size_t n = 0; n < triCount; ++n)
+    {
+        if (best == (size_t)-1)
+        {
+            // Nothing adjacent to the cache left: take the next unemitted one.
+            while (emitted[cursor]) ++cursor;
+            best = cursor;
+        }
+        const uint32_t* tri = indices + best * 3;
+        out[n * 3 + 0] = tri[0]; out[n * 3 + 1] = tri[1]; out[n * 3 + 2] = tri[2];
+        emitted[best] = 1;
+
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint32_t v = tri[k];
+            uint32_t* list = &adj[adjOffset[v]];
+            for (uint32_t j = 0; j < remaining[v]; ++j)
+            {
+                if (list[j] == best) { list[j] = list[remaining[v] - 1]; break; }
+            }
+            --remaining[v];
+        }
+
+        // New LRU: the triangle's vertices in front, then the old order.
+        int nextCount = 0;
+        for (int k = 0; k < 3; ++k) next[nextCount++] = tri[k];
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            const uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) next[nextCount++] = v;
+        }
+
+        // Rescore everything that moved, including vertices that fell out.
+        for (int i = 0; i < nextCount; ++i)
+        {
+            const uint32_t v = next[i];
+            const int pos = (i < MESH_OPT_CACHE_SIZE) ? i : -1;
+            cachePos[v] = pos;
+            const float s = mesh_opt_vertex_score(tables, pos, remaining[v]);
+            const float delta = s - vScore[v];
+            vScore[v] = s;
+            const uint32_t* list = &adj[adjOffset[v]];
+            for (uint32_t j = 0; j < remaining[v]; ++j) tScore[list[j]] += delta;
+        }
+        cacheCount = std::min(nextCount, MESH_OPT_CACHE_SIZE);
+        std::copy(next, next + cacheCount, cache);
+
+        best = (size_t)-1;
+        float bestScore = -1.f;
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            const uint32_t v = cache[i];
+            const uint32_t* list = &adj[adjOffset[v]];
+            for (uint32_t j = 0; j < remaining[v]; ++j)
+            {
+                if (tScore[list[j]] > bestScore) { bestScore = tScore[list[j]]; best = list[j]; }
+            }
+        }
+    }
+    std::copy(out.begin(), out.end(), indices);
+}
+
+struct MeshOptCluster
+{
+    size_t begin;   // first index
+    size_t end;
+    float  sortKey;
+};
+
+static bool mesh_opt_cluster_before(const MeshOptCluster& a, const MeshOptCluster& b)
+{
+    return a.sortKey > b.sortKey;
+}
+
+// positions: xyz per vertex, stride in floats. Run after mesh_opt_vertex_cache.
+// The cluster order is kept only if the overdraw estimate improves; returns
+// the estimate of the order left in indices.
+float mesh_opt_overdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t stride, size_t vertexCount, float threshold)
+{
+    const size_t triCount = indexCount / 3;
+    const float inputOverdraw = mesh_opt_overdraw_estimate(indices, indexCount, positions, stride, vertexCount);
+    if (triCount < 2 * MESH_OPT_MIN_CLUSTER) return inputOverdraw;
+
+    std::vector<uint8_t> triMisses(triCount);
+    const size_t totalMisses = mesh_opt_fifo_misses(indices, indexCount, vertexCount, MESH_OPT_FIFO_SIZE, triMisses.data());
+    const float meshAcmr = (float)totalMisses / (float)triCount;
+
+    // Cut wherever the cluster so far is no worse than threshold x the mesh.
+    std::vector<MeshOptCluster> clusters;
+    size_t start = 0, misses = 0;
+    for (size_t t = 0; t < triCount; ++t)
+    {
+        misses += triMisses[t];
+        const size_t tris = t - start + 1;
+        if (t + 1 == triCount || (tris >= MESH_OPT_MIN_CLUSTER && (float)misses <= threshold * meshAcmr * (float)tris))
+        {
+            MeshOptCluster c = { start * 3, (t + 1) * 3, 0.f };
+            clusters.push_back(c);
+            start = t + 1;
+            misses = 0;
+        }
+    }
+    if (clusters.size() < 2) return inputOverdraw;
+
+    // Area-weighted centroid and normal per cluster; the key is how far the
+    // cluster faces away from the mesh centre.
+    std::vector<float> cc(clusters.size() * 3), cn(clusters.size() * 3);
+    float meshC[3] = { 0.f, 0.f, 0.f }, meshArea = 0.f;
+    for (size_t ci = 0; ci < clusters.size(); ++ci)
+    {
+        float c[3] = { 0.f, 0.f, 0.f }, nrm[3] = { 0.f, 0.f, 0.f }, area = 0.f;
+        for (size_t i = clusters[ci].begin; i < clusters[ci].end; i += 3)
+        {
+            const float* p0 = positions + indices[i] * stride;
+            const float* p1 = positions + indices[i + 1] * stride;
+            const float* p2 = positions + indices[i + 2] * stride;
+            const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const float a = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                c[k] += a * (p0[k] + p1[k] + p2[k]) / 3.f;
+                nrm[k] += n[k];
+            }
+            area += a;
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            meshC[k] += c[k];
+            cc[ci * 3 + k] = (area > 0.f) ? c[k] / area : positions[indices[clusters[ci].begin] * stride + k];
+            cn[ci * 3 + k] = nrm[k];
+        }
+        meshArea += area;
+    }
+    for (int k = 0; k < 3; ++k) meshC[k] = (meshArea > 0.f) ? meshC[k] / meshArea : 0.f;
+
+    for (size_t ci = 0; ci < clusters.size(); ++ci)
+    {
+        const float* n = &cn[ci * 3];
+        const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        float key = 0.f;
+        if (len > 0.f)
+        {
+            for (int k = 0; k < 3; ++k) key += (cc[ci * 3 + k] - meshC[k]) * n[k];
+            key /= len;
+        }
+        clusters[ci].sortKey = key;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), mesh_opt_cluster_before);
+
+    std::vector<uint32_t> out;
+    out.reserve(indexCount);
+    for (size_t ci = 0; ci < clusters.size(); ++ci)
+        out.insert(out.end(), indices + clusters[ci].begin, indices + clusters[ci].end);
+    out.insert(out.end(), indices + triCount * 3, indices + indexCount);
+    const float sortedOverdraw = mesh_opt_overdraw_estimate(out.data(), indexCount, positions, stride, vertexCount);
+    if (sortedOverdraw >= inputOverdraw) return inputOverdraw;
+    std::copy(out.begin(), out.end(), indices);
+    return sortedOverdraw;
+}
+
+// remap[old] = new, first use by the index order first; unreferenced
+// vertices keep their relative order at the end. Returns the referenced count.
+size_t mesh_opt_vertex_fetch_remap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    const uint32_t unset = 0xFFFFFFFFu;
+    for (size_t v = 0; v < vertexCount; ++v) remap[v] = unset;
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        if (remap[indices[i]] == unset) remap[indices[i]] = next++;
+    }
+    const size_t referenced = next;
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        if (remap[v] == unset) remap[v] = next++;
+    }
+    return referenced;
+}
+
+// ============================================================
+// Level of detail: greedy edge collapse under quadric error metrics
+// (Garland & Heckbert). A collapse moves every vertex at one position onto a
+// neighbour, never to a new point, so all LODs index the original vertex
+// buffer. Topology is taken over vertices welded by position; collapsing
+// position P into Q has to send each vertex at P to a vertex at Q it already
+// shares a triangle with, so the two sides of a UV seam collapse in step and
+// a seam vertex can't slide off onto one side. Edges with no twin among the
+// unwelded indices (open borders and attribute seams) add planes through the
+// edge to their quadrics, which holds those outlines in shape. With a class
+// per vertex (the dominant joint for skinned meshes) vertices only collapse
+// within their class, so skin-weight boundaries don't drift.
+
+#define MESH_OPT_BORDER_WEIGHT 10.f     // border plane weight, x edge length squared
+#define MESH_OPT_SIMPLIFY_PASSES 64
+
+// Symmetric 4x4 plane quadric, plus the total weight so errors come out as
+// mean squared distances.
+struct MeshOptQuadric
+{
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double w;
+};
+
+static void mesh_opt_quadric_add_plane(MeshOptQuadric* q, double a, double b, double c, double d, double w)
+{
+    q->a2 += w * a * a; q->ab += w * a * b; q->ac += w * a * c; q->ad += w * a * d;
+    q->b2 += w * b * b; q->bc += w * b * c; q->bd += w * b * d;
+    q->c2 += w * c * c; q->cd += w * c * d;
+    q->d2 += w * d * d;
+    q->w += w;
+}
+
+static void mesh_opt_quadric_add(MeshOptQuadric* q, const MeshOptQuadric& o)
+{
+    q->a2 += o.a2; q->ab += o.ab; q->ac += o.ac; q->ad += o.ad;
+    q->b2 += o.b2; q->bc += o.bc; q->bd += o.bd;
+    q->c2 += o.c2; q->cd += o.cd;
+    q->d2 += o.d2;
+    q->w += o.w;
+}
+
+// Mean squared distance of p from the quadric's planes.
+static double mesh_opt_quadric_error(const MeshOptQuadric& q, const float* p)
+{
+    const double x = p[0], y = p[1], z = p[2];
+    const double e = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z + q.d2
+        + 2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z + q.ad * x + q.bd * y + q.cd * z);
+    return (q.w > 0.0) ? std::max(e, 0.0) / q.w : 0.0;
+}
+
+// Unnormalized normal of the triangle p0 p1 p2.
+static void mesh_opt_triangle_normal(const float* p0, const float* p1, const float* p2, double n[3])
+{
+    const double e1[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+    const double e2[3] = { (double)p2[0] - p0[0], (double)p2[1] - p0[1], (double)p2[2] - p0[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+struct MeshOptCollapse
+{
+    uint32_t from;   // welded positions
+    uint32_t to;
+    float    error;
+};
+
+static bool mesh_opt_collapse_cheaper(const MeshOptCollapse& a, const MeshOptCollapse& b)
+{
+    return a.error < b.error;
+}
+
+static uint64_t mesh_opt_edge_key(uint32_t a, uint32_t b)
+{
+    return ((uint64_t)a << 32) | b;
+}
+
+struct MeshOptPositionLess
+{
+    const float* positions;
+    size_t       stride;
+
+    bool operator()(uint32_t a, uint32_t b) const
+    {
+        const float* pa = positions + a * stride;
+        const float* pb = positions + b * stride;
+        if (pa[0] != pb[0]) return pa[0] < pb[0];
+        if (pa[1] != pb[1]) return pa[1] < pb[1];
+        if (pa[2] != pb[2]) return pa[2] < pb[2];
+        return a < b;
+    }
+};
+
+// Checks that collapsing position `from` into `to` keeps every live vertex at
+// `from` connected to exactly one vertex at `to` (in the same class), and
+// that no surviving triangle around `from` flips. Fills target[v] for the
+// vertices at `from`.
+static bool mesh_opt_collapse_valid(const MeshOptCollapse& c, const uint32_t* indices, const uint32_t* adjacency, uint32_t adjBegin, uint32_t adjEnd,
+    const uint32_t* weld, const uint32_t* vertexClass, const float* positions, size_t stride, uint32_t* target)
+{
+    for (uint32_t a = adjBegin; a < adjEnd; ++a)
+    {
+        const uint32_t* tri = indices + (size_t)adjacency[a] * 3;
+        int fromK = -1, toK = -1;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (weld[tri[k]] == c.from) fromK = k;
+            else if (weld[tri[k]] == c.to) toK = k;
+        }
+        if (fromK < 0) continue;   // collapsed away earlier in this pass
+        const uint32_t v = tri[fromK];
+        if (toK >= 0)
+        {
+            const uint32_t t = tri[toK];
+            if (vertexClass && vertexClass[v] != vertexClass[t]) return false;
+            if (target[v] != 0xFFFFFFFFu && target[v] != t) return false;
+            target[v] = t;
+        }
+    }
+    for (uint32_t a = adjBegin; a < adjEnd; ++a)
+    {
+        const uint32_t* tri = indices + (size_t)adjacency[a] * 3;
+        int fromK = -1;
+        bool hasTo = false;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (weld[tri[k]] == c.from) fromK = k;
+            else if (weld[tri[k]] == c.to) hasTo = true;
+        }
+        if (fromK < 0 || hasTo) continue;   // the ones with both endpoints go away
+        if (target[tri[fromK]] == 0xFFFFFFFFu) return false;   // this side never meets `to`
+
+        const float* p[3] = { positions + tri[0] * stride, positions + tri[1] * stride, positions + tri[2] * stride };
+        double before[3], after[3];
+        mesh_opt_triangle_normal(p[0], p[1], p[2], before);
+        p[fromK] = positions + c.to * stride;
+        mesh_opt_triangle_normal(p[0], p[1], p[2], after);
+        if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0) return false;
+    }
+    return true;
+}
+
+// Simplifies toward targetIndexCount without exceeding targetError, both
+// errors relative to the mesh's largest extent. vertexClass may be NULL.
+// dst holds indexCount indices; returns how many were written, and the
+// error reached in *outError.
+size_t mesh_opt_simplify(uint32_t* dst, const uint32_t* indices, size_t indexCount, const float* positions, size_t stride, size_t vertexCount,
+    const uint32_t* vertexClass, size_t targetIndexCount, float targetError, float* outError)
+{
+    std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+    if (outError) *outError = 0.f;
+
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            lo[k] = std::min(lo[k], positions[result[i] * stride + k]);
+            hi[k] = std::max(hi[k], positions[result[i] * stride + k]);
+        }
+    }
+    const float extent = result.empty() ? 0.f : std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+    if (!(extent > 0.f) || result.size() <= targetIndexCount)
+    {
+        std::copy(result.begin(), result.end(), dst);
+        return result.size();
+    }
+    const double maxError = (double)targetError * extent;
+
+    // weld[v] is the lowest-numbered vertex sharing v's position.
+    std::vector<uint32_t> order(vertexCount), weld(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) order[v] = (uint32_t)v;
+    const MeshOptPositionLess positionLess = { positions, stride };
+    std::sort(order.begin(), order.end(), positionLess);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const float* p = positions + order[i] * stride;
+        const bool same = i > 0 && std::equal(p, p + 3, positions + order[i - 1] * stride);
+        weld[order[i]] = same ? weld[order[i - 1]] : order[i];
+    }
+
+    // Face planes weighted by area, then border planes for unwelded edges
+    // that have no opposite half-edge.
+    const MeshOptQuadric zero = {};
+    std::vector<MeshOptQuadric> quadrics(vertexCount, zero);
+    std::vector<uint64_t> halfEdges;
+    halfEdges.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        const float* p0 = positions + result[i] * stride;
+        double n[3];
+        mesh_opt_triangle_normal(p0, positions + result[i + 1] * stride, positions + result[i + 2] * stride, n);
+        const double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (int k = 0; k < 3; ++k) halfEdges.push_back(mesh_opt_edge_key(result[i + k], result[i + (k + 1) % 3]));
+        if (len <= 0.0) continue;
+        const double a = n[0] / len, b = n[1] / len, c = n[2] / len;
+        const double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+        for (int k = 0; k < 3; ++k) mesh_opt_quadric_add_plane(&quadrics[weld[result[i + k]]], a, b, c, d, 0.5 * len);
+    }
+    std::sort(halfEdges.begin(), halfEdges.end());
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        double n[3];
+        mesh_opt_triangle_normal(positions + result[i] * stride, positions + result[i + 1] * stride, positions + result[i + 2] * stride, n);
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint32_t v0 = result[i + k], v1 = result[i + (k + 1) % 3];
+            if (std::binary_search(halfEdges.begin(), halfEdges.end(), mesh_opt_edge_key(v1, v0))) continue;
+            const float* p0 = positions + v0 * stride;
+            const float* p1 = positions + v1 * stride;
+            const double e[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+            double m[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+            const double len = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+            if (len <= 0.0) continue;
+            m[0] /= len; m[1] /= len; m[2] /= len;
+            const double d = -(m[0] * p0[0] + m[1] * p0[1] + m[2] * p0[2]);
+            const double w = MESH_OPT_BORDER_WEIGHT * (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+            mesh_opt_quadric_add_plane(&quadrics[weld[v0]], m[0], m[1], m[2], d, w);
+            mesh_opt_quadric_add_plane(&quadrics[weld[v1]], m[0], m[1], m[2], d, w);
+        }
+    }
+
+    std::vector<uint32_t> adjOffsets(vertexCount + 1), adjacency, target(vertexCount, 0xFFFFFFFFu);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<MeshOptCollapse> collapses;
+    double reached = 0.0;
+    for (int pass = 0; pass < MESH_OPT_SIMPLIFY_PASSES && result.size() > targetIndexCount; ++pass)
+    {
+        const size_t triCount = result.size() / 3;
+
+        // Triangles around each welded position.
+        std::fill(adjOffsets.begin(), adjOffsets.end(), 0u);
+        for (size_t i = 0; i < result.size(); ++i) ++adjOffsets[weld[result[i]] + 1];
+        for (size_t v = 0; v < vertexCount; ++v) adjOffsets[v + 1] += adjOffsets[v];
+        adjacency.resize(result.size());
+        std::vector<uint32_t> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i) adjacency[fill[weld[result[i]]]++] = (uint32_t)(i / 3);
+
+        // Each welded edge once, in its cheaper direction.
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                const uint32_t a = weld[result[i + k]], b = weld[result[i + (k + 1) % 3]];
+                if (a >= b) continue;   // the other half-edge, or degenerate
+                MeshOptQuadric q = quadrics[a];
+                mesh_opt_quadric_add(&q, quadrics[b]);
+                const double toB = mesh_opt_quadric_error(q, positions + b * stride);
+                const double toA = mesh_opt_quadric_error(q, positions + a * stride);
+                MeshOptCollapse c;
+                c.from = (toB <= toA) ? a : b;
+                c.to = (toB <= toA) ? b : a;
+                c.error = (float)std::sqrt(std::min(toA, toB));
+                collapses.push_back(c);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), mesh_opt_collapse_cheaper);
+
+        std::fill(touched.begin(), touched.end(), (uint8_t)0);
+        size_t liveTris = triCount, applied = 0;
+        for (size_t ci = 0; ci < collapses.size() && liveTris * 3 > targetIndexCount; ++ci)
+        {
+            const MeshOptCollapse& c = collapses[ci];
+            if ((double)c.error > maxError) break;
+            if (touched[c.from] || touched[c.to]) continue;
+
+            const uint32_t adjBegin = adjOffsets[c.from], adjEnd = adjOffsets[c.from + 1];
+            for (uint32_t a = adjBegin; a < adjEnd; ++a)
+            {
+                const uint32_t* tri = &result[(size_t)adjacency[a] * 3];
+                for (int k = 0; k < 3; ++k) target[tri[k]] = 0xFFFFFFFFu;
+            }
+            if (!mesh_opt_collapse_valid(c, result.data(), adjacency.data(), adjBegin, adjEnd, weld.data(), vertexClass, positions, stride, target.data()))
+                continue;
+
+            // Apply in place; triangles with both endpoints become degenerate.
+            for (uint32_t a = adjBegin; a < adjEnd; ++a)
+            {
+                uint32_t* tri = &result[(size_t)adjacency[a] * 3];
+                bool hasFrom = false, hasTo = false;
+                for (int k = 0; k < 3; ++k)
+                {
+                    hasFrom |= weld[tri[k]] == c.from;
+                    hasTo |= weld[tri[k]] == c.to;
+                }
+                if (!hasFrom) continue;
+                if (hasTo) --liveTris;
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (weld[tri[k]] == c.from) tri[k] = target[tri[k]];
+                }
+            }
+            mesh_opt_quadric_add(&quadrics[c.to], quadrics[c.from]);
+            touched[c.from] = touched[c.to] = 1;
+            reached = std::max(reached, (double)c.error);
+            ++applied;
+        }
+
+        size_t out = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            const uint32_t a = weld[result[i]], b = weld[result[i + 1]], c = weld[result[i + 2]];
+            if (a == b || b == c || a == c) continue;
+            result[out++] = result[i]; result[out++] = result[i + 1]; result[out++] = result[i + 2];
+        }
+        result.resize(out);
+        if (applied == 0) break;
+    }
+
+    if (outError) *outError = (float)(reached / extent);
+    std::copy(result.begin(), result.end(), dst);
+    return result.size();
+}
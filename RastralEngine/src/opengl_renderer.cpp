@@ -1,10 +1,200 @@
 #include <cstdio>
+#include <cstdint>
+#include <cstring>
 #include <vector>
+#include <string>
+#include <algorithm>
 #include <GL/glew.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "renderer.h"
 
+// --------------- State cache ---------------
+// Shadow of the binds the renderer repeats per draw: program, VAO, the
+// active unit, 2D and buffer texture per unit, generic buffer targets and
+// indexed UBO ranges. A call that wouldn't change GL state is skipped; issued and
+// skipped calls are counted per frame. Code that binds with raw gl* calls
+// (benchmarks, tools) must call GLStateInvalidate afterwards, and objects
+// are deleted through the helpers here so a recycled name isn't taken as
+// still bound. The element array buffer is VAO state and isn't cached.
+#define GL_STATE_TEXTURE_UNITS  8
+#define GL_STATE_UBO_BINDINGS   8
+#define GL_STATE_UNKNOWN        0xFFFFFFFFu
+
+enum GLStateCall { GLS_PROGRAM, GLS_VAO, GLS_ACTIVE_TEXTURE, GLS_TEXTURE, GLS_BUFFER, GLS_UBO_RANGE, GLS_CALL_KINDS };
+static const char* kGLStateCallNames[GLS_CALL_KINDS] = { "program", "vao", "unit", "texture", "buffer", "ubo" };
+
+// Generic targets with a cache slot; others pass straight through.
+static const GLenum kGLStateBufferTargets[] = {
+    GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+    GL_DRAW_INDIRECT_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_TEXTURE_BUFFER
+};
+#define GL_STATE_BUFFER_TARGETS (int)(sizeof(kGLStateBufferTargets) / sizeof(kGLStateBufferTargets[0]))
+
+struct GLStateCounters {
+    int issued[GLS_CALL_KINDS];
+    int skipped[GLS_CALL_KINDS];
+};
+
+struct GLUniformBinding {
+    GLuint     buffer;
+    GLintptr   offset;
+    GLsizeiptr size;
+};
+
+struct GLStateCache {
+    GLuint program;
+    GLuint vao;
+    GLuint activeUnit;
+    GLuint textures[GL_STATE_TEXTURE_UNITS];         // GL_TEXTURE_2D
+    GLuint bufferTextures[GL_STATE_TEXTURE_UNITS];   // GL_TEXTURE_BUFFER
+    GLuint buffers[GL_STATE_BUFFER_TARGETS];
+    GLUniformBinding ubo[GL_STATE_UBO_BINDINGS];
+    GLStateCounters frame;     // since GLStateBeginFrame
+    GLStateCounters last;      // the previous frame
+    unsigned long long frames;
+    GLStateCache();
+};
+GLStateCache g_glState;
+int gGLStateLogFrames = 300;   // frames between "[glstate]" log lines, 0 for none
+
+void GLStateInvalidate() {
+    GLStateCache& c = g_glState;
+    c.program = c.vao = c.activeUnit = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_TEXTURE_UNITS; ++i) c.textures[i] = c.bufferTextures[i] = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_BUFFER_TARGETS; ++i) c.buffers[i] = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_UBO_BINDINGS; ++i) c.ubo[i].buffer = GL_STATE_UNKNOWN;
+}
+
+GLStateCache::GLStateCache() : frames(0) {
+    std::memset(&frame, 0, sizeof(frame));
+    std::memset(&last, 0, sizeof(last));
+    std::memset(ubo, 0, sizeof(ubo));
+    GLStateInvalidate();
+}
+
+static inline bool GLStateSkip(GLuint& cached, GLuint value, GLStateCall kind) {
+    if (cached == value) { ++g_glState.frame.skipped[kind]; return true; }
+    cached = value;
+    ++g_glState.frame.issued[kind];
+    return false;
+}
+
+static int GLStateBufferSlot(GLenum target) {
+    for (int i = 0; i < GL_STATE_BUFFER_TARGETS; ++i) {
+        if (kGLStateBufferTargets[i] == target) return i;
+    }
+    return -1;
+}
+
+// Rolls the counters over; logs every gGLStateLogFrames frames.
+void GLStateBeginFrame() {
+    GLStateCache& c = g_glState;
+    c.last = c.frame;
+    std::memset(&c.frame, 0, sizeof(c.frame));
+    ++c.frames;
+    if (gGLStateLogFrames > 0 && c.frames % (unsigned long long)gGLStateLogFrames == 0) {
+        char line[512];
+        int n = std::snprintf(line, sizeof(line), "[glstate]");
+        int issued = 0, skipped = 0;
+        for (int k = 0; k < GLS_CALL_KINDS && n < (int)sizeof(line); ++k) {
+            n += std::snprintf(line + n, sizeof(line) - n, " %s %d/%d", kGLStateCallNames[k], c.last.issued[k], c.last.skipped[k]);
+            issued += c.last.issued[k];
+            skipped += c.last.skipped[k];
+        }
+        std::fprintf(stderr, "%s issued/skipped, %d issued %d skipped last frame\n", line, issued, skipped);
+    }
+}
+
+const GLStateCounters& GLStateLastFrame() { return g_glState.last; }
+
+void UseProgram(GLuint program) {
+    if (!GLStateSkip(g_glState.program, program, GLS_PROGRAM)) glUseProgram(program);
+}
+
+void BindVAO(GLuint vao) {
+    if (!GLStateSkip(g_glState.vao, vao, GLS_VAO)) glBindVertexArray(vao);
+}
+
+void BindBuffer(GLenum target, GLuint buffer) {
+    const int slot = GLStateBufferSlot(target);
+    if (slot >= 0 && GLStateSkip(g_glState.buffers[slot], buffer, GLS_BUFFER)) return;
+    if (slot < 0) ++g_glState.frame.issued[GLS_BUFFER];
+    glBindBuffer(target, buffer);
+}
+
+// Indexed uniform range; also sets the generic GL_UNIFORM_BUFFER binding, as GL does.
+void BindUniformBufferRange(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    GLStateCache& c = g_glState;
+    if (index < GL_STATE_UBO_BINDINGS) {
+        GLUniformBinding& b = c.ubo[index];
+        if (b.buffer == buffer && b.offset == offset && b.size == size) { ++c.frame.skipped[GLS_UBO_RANGE]; return; }
+        b.buffer = buffer; b.offset = offset; b.size = size;
+    }
+    ++c.frame.issued[GLS_UBO_RANGE];
+    c.buffers[GLStateBufferSlot(GL_UNIFORM_BUFFER)] = buffer;
+    glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+}
+
+static void GLStateBindTexture(GLenum target, GLuint* units, GLuint unit, GLuint tex) {
+    GLStateCache& c = g_glState;
+    if (unit >= GL_STATE_TEXTURE_UNITS) {
+        c.activeUnit = unit;
+        ++c.frame.issued[GLS_ACTIVE_TEXTURE];
+        ++c.frame.issued[GLS_TEXTURE];
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, tex);
+        return;
+    }
+    if (units[unit] == tex) { ++c.frame.skipped[GLS_TEXTURE]; return; }
+    if (!GLStateSkip(c.activeUnit, unit, GLS_ACTIVE_TEXTURE)) glActiveTexture(GL_TEXTURE0 + unit);
+    units[unit] = tex;
+    ++c.frame.issued[GLS_TEXTURE];
+    glBindTexture(target, tex);
+}
+
+void BindTexture2D(GLuint unit, GLuint tex) { GLStateBindTexture(GL_TEXTURE_2D, g_glState.textures, unit, tex); }
+void BindTextureBuffer(GLuint unit, GLuint tex) { GLStateBindTexture(GL_TEXTURE_BUFFER, g_glState.bufferTextures, unit, tex); }
+
+// Deleting a bound object unbinds it in GL; drop it from the shadow too.
+void GLStateForgetProgram(GLuint program) {
+    if (g_glState.program == program) g_glState.program = GL_STATE_UNKNOWN;
+}
+
+void GLStateForgetVAO(GLuint vao) {
+    if (g_glState.vao == vao) g_glState.vao = GL_STATE_UNKNOWN;
+}
+
+void GLStateForgetTexture(GLuint tex) {
+    for (int i = 0; i < GL_STATE_TEXTURE_UNITS; ++i) {
+        if (g_glState.textures[i] == tex) g_glState.textures[i] = GL_STATE_UNKNOWN;
+        if (g_glState.bufferTextures[i] == tex) g_glState.bufferTextures[i] = GL_STATE_UNKNOWN;
+    }
+}
+
+void GLStateForgetBuffer(GLuint buffer) {
+    for (int i = 0; i < GL_STATE_BUFFER_TARGETS; ++i) {
+        if (g_glState.buffers[i] == buffer) g_glState.buffers[i] = GL_STATE_UNKNOWN;
+    }
+    for (int i = 0; i < GL_STATE_UBO_BINDINGS; ++i) {
+        if (g_glState.ubo[i].buffer == buffer) g_glState.ubo[i].buffer = GL_STATE_UNKNOWN;
+    }
+}
+
+void DeleteBuffer(GLuint& buffer) {
+    if (!buffer) return;
+    GLStateForgetBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void DeleteVAO(GLuint& vao) {
+    if (!vao) return;
+    GLStateForgetVAO(vao);
+    glDeleteVertexArrays(1, &vao);
+    vao = 0;
+}
+
 // --------------- Viewport / RT ---------------
 void SetViewportSize(int width, int height) {
     g_view_w = (width > 0) ? width : 1;
@@ -18,10 +208,10 @@ void CreateFullscreenQuad(GLuint* vao, GLuint* vbo) {
         -1.f,-1.f, 0.f,0.f,   1.f, 1.f, 1.f,1.f,  -1.f, 1.f, 0.f,1.f
     };
     glGenVertexArrays(1, vao);
-    glBindVertexArray(*vao);
+    BindVAO(*vao);
 
     glGenBuffers(1, vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, *vbo);
+    BindBuffer(GL_ARRAY_BUFFER, *vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(fsq), fsq, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
@@ -29,18 +219,20 @@ void CreateFullscreenQuad(GLuint* vao, GLuint* vbo) {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
+    BindVAO(0);
 }
 
 bool CreateRenderTarget(RenderTarget& rt, int w, int h) {
     rt.w = (w > 0) ? w : 1;
     rt.h = (h > 0) ? h : 1;
+    rt.vw = rt.w;
+    rt.vh = rt.h;
 
     glGenFramebuffers(1, &rt.fbo);
     glBindFramebuffer(GL_FRAMEBUFFER, rt.fbo);
 
     glGenTextures(1, &rt.color);
-    glBindTexture(GL_TEXTURE_2D, rt.color);
+    BindTexture2D(0, rt.color);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, rt.w, rt.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -59,58 +251,257 @@ bool CreateRenderTarget(RenderTarget& rt, int w, int h) {
     return status == GL_FRAMEBUFFER_COMPLETE;
 }
 
+// Binds rt with the viewport on its active rectangle.
 void BeginRenderTarget(const RenderTarget& rt) {
     glBindFramebuffer(GL_FRAMEBUFFER, rt.fbo);
-    glViewport(0, 0, rt.w, rt.h);
+    glViewport(0, 0, rt.vw, rt.vh);
 }
 void EndRenderTarget() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
 
 void DestroyRenderTarget(RenderTarget& rt) {
     if (rt.depth) { glDeleteRenderbuffers(1, &rt.depth); rt.depth = 0; }
-    if (rt.color) { glDeleteTextures(1, &rt.color); rt.color = 0; }
+    if (rt.color) { GLStateForgetTexture(rt.color); glDeleteTextures(1, &rt.color); rt.color = 0; }
     if (rt.fbo) { glDeleteFramebuffers(1, &rt.fbo); rt.fbo = 0; }
     rt.w = 0; rt.h = 0;
+    rt.vw = 0; rt.vh = 0;
+}
+
+// Reallocates only to grow, so a shrinking rectangle never costs an allocation;
+// the active rectangle is left for SetRenderTargetRect.
+bool EnsureRenderTargetSize(RenderTarget& rt, int w, int h) {
+    if (rt.fbo && w <= rt.w && h <= rt.h) return true;
+    const int vw = rt.vw, vh = rt.vh;
+    const int nw = std::max(w, rt.w), nh = std::max(h, rt.h);
+    DestroyRenderTarget(rt);
+    const bool ok = CreateRenderTarget(rt, nw, nh);
+    rt.vw = std::min(std::max(vw, 1), rt.w);
+    rt.vh = std::min(std::max(vh, 1), rt.h);
+    return ok;
+}
+
+void SetRenderTargetRect(RenderTarget& rt, int w, int h) {
+    rt.vw = std::min(std::max(w, 1), rt.w);
+    rt.vh = std::min(std::max(h, 1), rt.h);
+}
+
+// Texcoord scale from a full-screen [0,1] quad onto rt's active rectangle,
+// and the largest texcoord whose bilinear footprint stays inside it.
+void RenderTargetSampleRect(const RenderTarget& rt, float out[4]) {
+    const float w = (float)std::max(rt.w, 1), h = (float)std::max(rt.h, 1);
+    out[0] = (float)rt.vw / w;
+    out[1] = (float)rt.vh / h;
+    out[2] = ((float)rt.vw - 0.5f) / w;
+    out[3] = ((float)rt.vh - 0.5f) / h;
 }
 
 // --------------- Frame ---------------
-void BeginFrame(float r, float g, float b, float a) {
-    glViewport(0, 0, g_view_w, g_view_h);
+// Clears whatever is bound, leaving the viewport alone.
+void ClearFrame(float r, float g, float b, float a) {
     glClearColor(r, g, b, a);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
+void BeginFrame(float r, float g, float b, float a) {
+    glViewport(0, 0, g_view_w, g_view_h);
+    ClearFrame(r, g, b, a);
+}
 void EndFrame() { glFlush(); }
 
 // --------------- Shader / VAO ---------------
-void BeginShader(GLuint program) { glUseProgram(program); }
-void EndShader() { glUseProgram(0); }
-void BindVAO(GLuint vao) { glBindVertexArray(vao); }
+void BeginShader(GLuint program) { UseProgram(program); }
+void EndShader() { UseProgram(0); }
 
-// --------------- UBOs ---------------
-void CreateUBOs() {
-    if (!g_uboPerFrame) glGenBuffers(1, &g_uboPerFrame);
-    if (!g_uboPerDraw)  glGenBuffers(1, &g_uboPerDraw);
-    if (!g_uboViz)      glGenBuffers(1, &g_uboViz);
-    if (!g_uboSkin)     glGenBuffers(1, &g_uboSkin); // NEW
+// --------------- Uniform ring ---------------
+// All per-frame and per-draw uniform data lives in one buffer split into
+// UNIFORM_RING_FRAMES regions. A frame fills its region front to back with
+// aligned blocks, each bound with glBindBufferRange, and a fence at the end
+// of the frame guards the region until the GPU has read it. With
+// ARB_buffer_storage the buffer is persistently mapped and blocks are written
+// in place; otherwise each block is a glBufferSubData into a range the GPU
+// is done with.
+#define UNIFORM_RING_FRAMES   3
+#define UNIFORM_RING_ALIGN    256
+#define UNIFORM_RING_REGION   (1024 * 1024)   // initial bytes per frame, grows
+#define UNIFORM_RING_RETIRED  4
+
+// Skin palettes are bound as a whole SkinUBO window, which may run past the
+// palette into the next block; the buffer keeps one window of tail slack.
+#define SKIN_PALETTE_WINDOW ((GLsizeiptr)sizeof(SkinUBO))
+
+struct UniformRange {
+    GLuint   buffer;
+    GLintptr offset;
+};
+
+struct UniformRing {
+    GLuint         buffer;
+    unsigned char* mapped;            // null on the glBufferSubData path
+    bool           persistent;
+    GLintptr       align;
+    GLsizeiptr     regionSize;
+    GLsync         fences[UNIFORM_RING_FRAMES];
+    int            frame;             // region being filled
+    GLsizeiptr     head;              // bytes used in the region
+    GLsizeiptr     frameBytes;        // bytes asked for this frame, across growth
+    GLsizeiptr     highWater;
+    GLuint         retired[UNIFORM_RING_RETIRED];   // outgrown buffers, freed once their frames retire
+    GLsync         retiredFence[UNIFORM_RING_RETIRED];
+    int            retiredCount;
+    int            fenceWaits;        // frames that blocked on the GPU
+    int            growths;
+    UniformRing() : buffer(0), mapped(nullptr), persistent(false), align(UNIFORM_RING_ALIGN), regionSize(0), frame(0), head(0),
+        frameBytes(0), highWater(0), retiredCount(0), fenceWaits(0), growths(0) {
+        for (int i = 0; i < UNIFORM_RING_FRAMES; ++i) fences[i] = 0;
+        for (int i = 0; i < UNIFORM_RING_RETIRED; ++i) { retired[i] = 0; retiredFence[i] = 0; }
+    }
+};
+UniformRing g_uniformRing;
 
-    glBindBuffer(GL_UNIFORM_BUFFER, g_uboPerFrame);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(PerFrameUBO), nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, g_uboPerFrame);
+static bool FenceSignaled(GLsync fence, GLuint64 timeoutNs) {
+    const GLenum r = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNs);
+    return r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED || r == GL_WAIT_FAILED;
+}
 
-    glBindBuffer(GL_UNIFORM_BUFFER, g_uboPerDraw);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(PerDrawUBO), nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 1, g_uboPerDraw);
+static void RingCreateBuffer(GLsizeiptr regionSize) {
+    UniformRing& r = g_uniformRing;
+    const GLsizeiptr total = regionSize * UNIFORM_RING_FRAMES + SKIN_PALETTE_WINDOW;
+    glGenBuffers(1, &r.buffer);
+    BindBuffer(GL_UNIFORM_BUFFER, r.buffer);
+    r.mapped = nullptr;
+    if (r.persistent) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, total, nullptr, flags);
+        r.mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, total, flags);
+        if (!r.mapped) {
+            // Storage is immutable; start over with a plain buffer.
+            std::fprintf(stderr, "[ubo] persistent map failed, using glBufferSubData\n");
+            DeleteBuffer(r.buffer);
+            glGenBuffers(1, &r.buffer);
+            BindBuffer(GL_UNIFORM_BUFFER, r.buffer);
+            r.persistent = false;
+        }
+    }
+    if (!r.mapped) glBufferData(GL_UNIFORM_BUFFER, total, nullptr, GL_DYNAMIC_DRAW);
 
-    glBindBuffer(GL_UNIFORM_BUFFER, g_uboViz);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(VizParamsUBO), nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 2, g_uboViz);
+    // A fresh buffer has no frames in flight.
+    for (int i = 0; i < UNIFORM_RING_FRAMES; ++i) {
+        if (r.fences[i]) { glDeleteSync(r.fences[i]); r.fences[i] = 0; }
+    }
+    r.regionSize = regionSize;
+    r.head = 0;
+}
 
-    // Allocate a generous palette (128 bones * 64 bytes each = 8 KB, plus a small tail)
-    const GLsizeiptr skinBytes = (GLsizeiptr)(sizeof(SkinUBO));
-    glBindBuffer(GL_UNIFORM_BUFFER, g_uboSkin);
-    glBufferData(GL_UNIFORM_BUFFER, skinBytes, nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 3, g_uboSkin); // binding = 3
+// Replaces the buffer with one whose regions hold at least 'bytes'. Ranges
+// already handed out keep pointing at the old buffer, which stays alive
+// until the fence placed at the end of this frame signals.
+static void RingGrow(GLsizeiptr bytes) {
+    UniformRing& r = g_uniformRing;
+    if (r.retiredCount == UNIFORM_RING_RETIRED) {
+        glFinish();
+        for (int i = 0; i < r.retiredCount; ++i) {
+            DeleteBuffer(r.retired[i]);
+            if (r.retiredFence[i]) glDeleteSync(r.retiredFence[i]);
+        }
+        r.retiredCount = 0;
+    }
+    r.retired[r.retiredCount] = r.buffer;
+    r.retiredFence[r.retiredCount] = 0;
+    ++r.retiredCount;
+    ++r.growths;
+
+    GLsizeiptr size = bytes + bytes / 2;
+    size = (size + r.align - 1) & ~(r.align - 1);
+    RingCreateBuffer(size);
+}
 
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+static UniformRange RingAlloc(GLsizeiptr bytes) {
+    UniformRing& r = g_uniformRing;
+    const GLsizeiptr padded = (bytes + r.align - 1) & ~(r.align - 1);
+    if (r.head + padded > r.regionSize) RingGrow(r.frameBytes + padded);
+    UniformRange out = { r.buffer, (GLintptr)(r.frame * r.regionSize + r.head) };
+    r.head += padded;
+    r.frameBytes += padded;
+    if (r.frameBytes > r.highWater) r.highWater = r.frameBytes;
+    return out;
+}
+
+static UniformRange RingWrite(const void* data, GLsizeiptr bytes) {
+    UniformRing& r = g_uniformRing;
+    const UniformRange out = RingAlloc(bytes);
+    if (r.mapped) {
+        memcpy(r.mapped + out.offset, data, (size_t)bytes);
+    }
+    else {
+        BindBuffer(GL_UNIFORM_BUFFER, out.buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, out.offset, bytes, data);
+    }
+    return out;
+}
+
+// Call before the frame's first uniform update. expectedBytes is a hint for
+// the frame's total (0 if unknown); the ring also grows to the largest frame
+// it has seen so far.
+void BeginUniformFrame(GLsizeiptr expectedBytes) {
+    UniformRing& r = g_uniformRing;
+    int kept = 0;
+    for (int i = 0; i < r.retiredCount; ++i) {
+        if (r.retiredFence[i] && FenceSignaled(r.retiredFence[i], 0)) {
+            DeleteBuffer(r.retired[i]);
+            glDeleteSync(r.retiredFence[i]);
+        }
+        else {
+            r.retired[kept] = r.retired[i];
+            r.retiredFence[kept] = r.retiredFence[i];
+            ++kept;
+        }
+    }
+    r.retiredCount = kept;
+
+    const GLsizeiptr want = std::max(expectedBytes, r.highWater);
+    if (want > r.regionSize) RingGrow(want);
+
+    GLsync& fence = r.fences[r.frame];
+    if (fence) {
+        if (!FenceSignaled(fence, 0)) {
+            ++r.fenceWaits;
+            while (!FenceSignaled(fence, 1000000)) {}
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+    r.head = 0;
+    r.frameBytes = 0;
+}
+
+// Call after the frame's last draw.
+void EndUniformFrame() {
+    UniformRing& r = g_uniformRing;
+    r.fences[r.frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    for (int i = 0; i < r.retiredCount; ++i) {
+        if (!r.retiredFence[i]) r.retiredFence[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    r.frame = (r.frame + 1) % UNIFORM_RING_FRAMES;
+}
+
+// Bytes one block of 'bytes' takes in the ring, for BeginUniformFrame hints.
+GLsizeiptr UniformBlockBytes(GLsizeiptr bytes) {
+    return (bytes + g_uniformRing.align - 1) & ~(g_uniformRing.align - 1);
+}
+
+void BindUniformRange(GLuint binding, const UniformRange& range, GLsizeiptr bytes) {
+    BindUniformBufferRange(binding, range.buffer, range.offset, bytes);
+}
+
+// --------------- UBOs ---------------
+void CreateUBOs() {
+    UniformRing& r = g_uniformRing;
+    if (r.buffer) return;
+    GLint align = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    r.align = std::max((GLintptr)align, (GLintptr)UNIFORM_RING_ALIGN);
+    r.persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    RingCreateBuffer(UNIFORM_RING_REGION);
+    std::printf("[ubo] uniform ring: %d x %lld KB, %s\n", UNIFORM_RING_FRAMES, (long long)(r.regionSize / 1024),
+        r.mapped ? "persistent mapped" : "glBufferSubData");
 }
 
 void BindUBOsForMesh(GLuint program) {
@@ -132,47 +523,235 @@ void BindUBOsForVisualizer(GLuint program) {
     if (idx != GL_INVALID_INDEX) glUniformBlockBinding(program, idx, 2);
 }
 
-void UpdatePerFrameUBO(const float projView16[16]) {
-    PerFrameUBO data;
+// drawRecordBase: FrameDataTexel of the frame's DrawRecords, 0 without multi-draw.
+void UpdatePerFrameUBO(const float projView16[16], int32_t drawRecordBase = 0) {
+    PerFrameUBO data = {};
     memcpy(data.uProjView, projView16, 16 * sizeof(float));
-    glBindBuffer(GL_UNIFORM_BUFFER, g_uboPerFrame);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PerFrameUBO), &data);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    data.uDrawRecordBase = drawRecordBase;
+    BindUniformRange(0, RingWrite(&data, sizeof(data)), sizeof(data));
 }
 
 void UpdatePerDrawUBO(const float model16[16], const float tint4[4]) {
     PerDrawUBO data;
     memcpy(data.uModel, model16, 16 * sizeof(float));
     memcpy(data.uTint, tint4, 4 * sizeof(float));
-    glBindBuffer(GL_UNIFORM_BUFFER, g_uboPerDraw);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PerDrawUBO), &data);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-}
-
-// NEW: upload bone palette
-void UpdateSkinUBO(const float* boneMats16xN, int boneCount) {
-    struct Packed {
-        float uBones[128][16];
-        int   uBoneCount;
-        int   _pad[3];
-    } pack{};
+    BindUniformRange(1, RingWrite(&data, sizeof(data)), sizeof(data));
+}
+
+// --------------- Skin palettes ---------------
+// Each distinct palette of a frame is written to the ring once, sized to its
+// bone count, and draws bind a SKIN_PALETTE_WINDOW range at its offset.
+struct SkinPaletteFrame {
+    std::vector<uint64_t>     slotHash;     // open-addressed dedupe table, 0 = empty
+    std::vector<const float*> slotBones;    // first palette seen with the hash
+    std::vector<int>          slotCount;    // its bone count
+    std::vector<UniformRange> slotRange;
+    UniformRange identity;
+    const float* lastBones;                 // fast path for draws sharing a skin
+    int          lastCount;
+    UniformRange lastRange;
+    GLsizeiptr   bytes;                     // written this frame
+    int          uploads;                   // palettes written this frame, after dedupe
+    int          requests;
+    SkinPaletteFrame() : lastBones(nullptr), lastCount(0), bytes(0), uploads(0), requests(0) {
+        identity.buffer = lastRange.buffer = 0;
+        identity.offset = lastRange.offset = 0;
+    }
+};
+SkinPaletteFrame g_skinFrame;
+
+// Hashes only each bone's translation column, which differs whenever the
+// pose does; hits are confirmed with a full compare.
+static uint64_t HashPalette(const float* m, int boneCount) {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ (uint64_t)boneCount;
+    for (int b = 0; b < boneCount; ++b) {
+        uint64_t w[2];
+        memcpy(w, m + (size_t)b * 16 + 12, sizeof(w));
+        h = (h ^ w[0]) * 0x100000001B3ull;
+        h = (h ^ w[1]) * 0x100000001B3ull;
+        h ^= h >> 29;
+    }
+    return h ? h : 1;
+}
+
+static UniformRange WritePalette(const float* m, int boneCount) {
+    const GLsizeiptr bytes = (GLsizeiptr)boneCount * 16 * sizeof(float);
+    g_skinFrame.bytes += bytes;
+    ++g_skinFrame.uploads;
+    return RingWrite(m, bytes);
+}
+
+// Call after BeginUniformFrame and before the frame's first PushSkinPalette;
+// maxPalettes sizes the dedupe table so steady frames don't allocate.
+void BeginSkinPalettes(int maxPalettes) {
+    size_t slots = 16;
+    while (slots < (size_t)maxPalettes * 2) slots <<= 1;
+    if (g_skinFrame.slotHash.size() < slots) {
+        g_skinFrame.slotHash.resize(slots);
+        g_skinFrame.slotBones.resize(slots);
+        g_skinFrame.slotCount.resize(slots);
+        g_skinFrame.slotRange.resize(slots);
+    }
+    std::fill(g_skinFrame.slotHash.begin(), g_skinFrame.slotHash.end(), 0);
+
+    g_skinFrame.lastBones = nullptr;
+    g_skinFrame.lastCount = 0;
+    g_skinFrame.bytes = 0;
+    g_skinFrame.uploads = g_skinFrame.requests = 0;
+
+    // Identity in bone 0 for static draws.
+    static const float identity[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+    g_skinFrame.identity = WritePalette(identity, 1);
+}
+
+// Returns where the palette lives this frame. The same pointer, or identical
+// contents, are written only once per frame; palettes already pushed must
+// stay unchanged until the frame's last push.
+UniformRange PushSkinPalette(const float* boneMats16xN, int boneCount) {
+    ++g_skinFrame.requests;
     const int N = (boneCount > 128) ? 128 : boneCount;
-    if (boneMats16xN && N > 0) {
-        memcpy(pack.uBones, boneMats16xN, N * 16 * sizeof(float));
+    if (!boneMats16xN || N <= 0) return g_skinFrame.identity;
+    if (boneMats16xN == g_skinFrame.lastBones && N == g_skinFrame.lastCount) return g_skinFrame.lastRange;
+
+    const size_t bytes = (size_t)N * 16 * sizeof(float);
+    const uint64_t h = HashPalette(boneMats16xN, N);
+    const size_t mask = g_skinFrame.slotHash.size() - 1;
+    size_t slot = (size_t)h & mask;
+    bool found = false;
+    UniformRange range = g_skinFrame.identity;
+    for (size_t probe = 0; probe <= mask; ++probe, slot = (slot + 1) & mask) {
+        const uint64_t sh = g_skinFrame.slotHash[slot];
+        if (sh == 0) {
+            range = WritePalette(boneMats16xN, N);
+            g_skinFrame.slotHash[slot] = h;
+            g_skinFrame.slotBones[slot] = boneMats16xN;
+            g_skinFrame.slotCount[slot] = N;
+            g_skinFrame.slotRange[slot] = range;
+            found = true;
+            break;
+        }
+        if (sh == h && g_skinFrame.slotCount[slot] == N && memcmp(g_skinFrame.slotBones[slot], boneMats16xN, bytes) == 0) {
+            range = g_skinFrame.slotRange[slot];
+            found = true;
+            break;
+        }
     }
-    else {
-        // Identity in slot 0 makes non-skinned/dummy-safe
-        for (int i = 0; i < 16; ++i) pack.uBones[0][i] = (i % 5 == 0) ? 1.f : 0.f;
+    if (!found) range = WritePalette(boneMats16xN, N);   // table full
+
+    g_skinFrame.lastBones = boneMats16xN;
+    g_skinFrame.lastCount = N;
+    g_skinFrame.lastRange = range;
+    return range;
+}
+
+void BindSkinPalette(const UniformRange& range) {
+    BindUniformRange(3, range, SKIN_PALETTE_WINDOW);
+}
+
+// --------------- Multi-draw ---------------
+// Draw records, indirect commands and palettes all live in the uniform
+// ring; the INSTANCED variant reads records and palettes through one
+// texture buffer over the ring buffer. Attribute 4 is an instanced 0..n-1
+// index, so a command's baseInstance selects its record with no shader
+// draw parameters. Everything a frame submits must be in the same ring
+// buffer: a ring that grows mid-frame falls back to per-draw submission.
+#define DRAW_RECORD_TEXELS  ((int)(sizeof(DrawRecord) / 16))
+#define DRAW_RECORD_UNIT    1      // texture unit of uDrawRecords
+#define DRAW_INDEX_ATTRIB   4
+
+struct MultiDraw {
+    bool   ready;
+    bool   supported;
+    GLint  maxTexels;        // GL_MAX_TEXTURE_BUFFER_SIZE
+    GLuint indexBuffer;      // 0, 1, 2, ... for DRAW_INDEX_ATTRIB
+    int    capacity;
+    GLuint recordTexture;    // RGBA32F view of the ring
+    GLuint viewedBuffer;     // ring buffer the view was made for
+    MultiDraw() : ready(false), supported(false), maxTexels(0), indexBuffer(0), capacity(0), recordTexture(0), viewedBuffer(0) {}
+};
+MultiDraw g_multiDraw;
+
+bool MultiDrawSupported() {
+    MultiDraw& m = g_multiDraw;
+    if (!m.ready) {
+        m.ready = true;
+        m.supported = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_draw_indirect && GLEW_ARB_base_instance);
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &m.maxTexels);
+        std::fprintf(stderr, "[draw] multi-draw indirect %s\n", m.supported ? "on" : "unavailable");
     }
-    pack.uBoneCount = N;
+    return m.supported;
+}
+
+// Room for 'count' records; the buffer keeps its name, so VAOs stay attached.
+void EnsureDrawIndexCapacity(int count) {
+    MultiDraw& m = g_multiDraw;
+    if (m.indexBuffer && count <= m.capacity) return;
+    int capacity = 1024;
+    while (capacity < count) capacity *= 2;
+    std::vector<uint32_t> ids((size_t)capacity);
+    for (int i = 0; i < capacity; ++i) ids[(size_t)i] = (uint32_t)i;
+    if (!m.indexBuffer) glGenBuffers(1, &m.indexBuffer);
+    BindBuffer(GL_ARRAY_BUFFER, m.indexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(ids.size() * sizeof(uint32_t)), ids.data(), GL_STATIC_DRAW);
+    m.capacity = capacity;
+}
+
+// Adds the instanced draw index to a mesh VAO.
+void AttachDrawIndexAttribute(GLuint vao) {
+    if (!vao) return;
+    EnsureDrawIndexCapacity(0);
+    BindVAO(vao);
+    BindBuffer(GL_ARRAY_BUFFER, g_multiDraw.indexBuffer);
+    glVertexAttribIPointer(DRAW_INDEX_ATTRIB, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+    glVertexAttribDivisor(DRAW_INDEX_ATTRIB, 1);
+    glEnableVertexAttribArray(DRAW_INDEX_ATTRIB);
+    BindVAO(0);
+}
+
+// Copies a frame-lifetime block into the ring: records, commands.
+UniformRange WriteFrameData(const void* data, GLsizeiptr bytes) {
+    return RingWrite(data, bytes);
+}
+
+// Ring offset to a texel index in the record view.
+int32_t FrameDataTexel(const UniformRange& range) {
+    return (int32_t)(range.offset / 16);
+}
+
+// Points the record view at the current ring buffer and binds it; false
+// when the buffer is too large for a texture buffer.
+bool BindDrawRecords() {
+    MultiDraw& m = g_multiDraw;
+    const UniformRing& r = g_uniformRing;
+    const GLsizeiptr bytes = r.regionSize * UNIFORM_RING_FRAMES + SKIN_PALETTE_WINDOW;
+    if (bytes / 16 > (GLsizeiptr)m.maxTexels) return false;
+    if (!m.recordTexture) glGenTextures(1, &m.recordTexture);
+    BindTextureBuffer(DRAW_RECORD_UNIT, m.recordTexture);
+    if (m.viewedBuffer != r.buffer) {
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, r.buffer);
+        m.viewedBuffer = r.buffer;
+    }
+    return true;
+}
 
-    glBindBuffer(GL_UNIFORM_BUFFER, g_uboSkin);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Packed), &pack);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+// Draws commands [first, first + count) of a block written with WriteFrameData.
+void MultiDrawIndexed(GLenum indexType, const UniformRange& commands, int first, int count) {
+    BindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+    const GLintptr offset = commands.offset + (GLintptr)first * (GLintptr)sizeof(DrawElementsIndirectCommand);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (const void*)offset, count, 0);
 }
 
+void DestroyMultiDraw() {
+    MultiDraw& m = g_multiDraw;
+    DeleteBuffer(m.indexBuffer);
+    if (m.recordTexture) { GLStateForgetTexture(m.recordTexture); glDeleteTextures(1, &m.recordTexture); m.recordTexture = 0; }
+    m.viewedBuffer = 0;
+    m.capacity = 0;
+}
+
+// sceneUV from RenderTargetSampleRect.
 void UpdateVizParamsUBO(float resX, float resY, float time, float beatPhase, float barPhase, int state,
-    float rage, float drums, float bass, float perc, float synth, float levelLead) {
+    float rage, float drums, float bass, float perc, float synth, float levelLead, const float sceneUV[4]) {
     VizParamsUBO v = {};
     v.uRes[0] = resX;  v.uRes[1] = resY;
     v.uTime = time;
@@ -182,23 +761,183 @@ void UpdateVizParamsUBO(float resX, float resY, float time, float beatPhase, flo
     v.uRage = rage;
     v.uLevelsA[0] = drums; v.uLevelsA[1] = bass; v.uLevelsA[2] = perc; v.uLevelsA[3] = synth;
     v.uLevelLead = levelLead;
+    for (int i = 0; i < 4; ++i) v.uSceneUV[i] = sceneUV[i];
 
-    glBindBuffer(GL_UNIFORM_BUFFER, g_uboViz);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(VizParamsUBO), &v);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    BindUniformRange(2, RingWrite(&v, sizeof(v)), sizeof(v));
 }
 
 void DestroyUBOs() {
-    if (g_uboPerFrame) { glDeleteBuffers(1, &g_uboPerFrame); g_uboPerFrame = 0; }
-    if (g_uboPerDraw) { glDeleteBuffers(1, &g_uboPerDraw);  g_uboPerDraw = 0; }
-    if (g_uboViz) { glDeleteBuffers(1, &g_uboViz);      g_uboViz = 0; }
-    if (g_uboSkin) { glDeleteBuffers(1, &g_uboSkin);     g_uboSkin = 0; }
+    UniformRing& r = g_uniformRing;
+    for (int i = 0; i < UNIFORM_RING_FRAMES; ++i) {
+        if (r.fences[i]) { glDeleteSync(r.fences[i]); r.fences[i] = 0; }
+    }
+    for (int i = 0; i < r.retiredCount; ++i) {
+        DeleteBuffer(r.retired[i]);
+        if (r.retiredFence[i]) glDeleteSync(r.retiredFence[i]);
+    }
+    r.retiredCount = 0;
+    DeleteBuffer(r.buffer);
+    r.mapped = nullptr;
+}
+
+// --------------- GPU profiler ---------------
+// Named scopes timed with a GL_TIMESTAMP query at each end (GL_TIME_ELAPSED
+// queries can't nest, timestamps can). A frame's queries live in one of
+// GPU_PROFILER_FRAMES slots and are read when that slot comes round again,
+// so the GPU has had several frames to finish; a slot whose results still
+// aren't in is dropped instead of waited on. Times are averaged over the
+// last GPU_PROFILER_WINDOW frames that reported. Scope 0 is the whole frame.
+#define GPU_PROFILER_FRAMES  4
+#define GPU_PROFILER_SCOPES  8
+#define GPU_PROFILER_WINDOW  60
+
+struct GpuScopeStats {
+    const char* name;
+    float lastMs;
+    float avgMs;     // over the window
+    float maxMs;     // over the window
+    int   samples;   // in the window
+};
+
+struct GpuProfiler {
+    bool        ready;
+    bool        supported;
+    GLuint      queries[GPU_PROFILER_FRAMES][GPU_PROFILER_SCOPES * 2];   // begin, end per scope
+    bool        issued[GPU_PROFILER_FRAMES][GPU_PROFILER_SCOPES];
+    bool        pending[GPU_PROFILER_FRAMES];
+    int         frame;
+    const char* names[GPU_PROFILER_SCOPES];
+    int         scopeCount;
+    float       history[GPU_PROFILER_SCOPES][GPU_PROFILER_WINDOW];
+    int         historyCount[GPU_PROFILER_SCOPES];
+    int         historyHead[GPU_PROFILER_SCOPES];
+    float       lastMs[GPU_PROFILER_SCOPES];
+    int         dropped;         // slots not ready when they came round
+    unsigned long long resolved;     // frames read back
+    unsigned long long loggedAt;
+    GpuProfiler() : ready(false), supported(false), frame(0), scopeCount(0), dropped(0), resolved(0), loggedAt(0) {
+        std::memset(queries, 0, sizeof(queries));
+        std::memset(issued, 0, sizeof(issued));
+        std::memset(pending, 0, sizeof(pending));
+        std::memset(names, 0, sizeof(names));
+        std::memset(historyCount, 0, sizeof(historyCount));
+        std::memset(historyHead, 0, sizeof(historyHead));
+        std::memset(lastMs, 0, sizeof(lastMs));
+    }
+};
+GpuProfiler g_gpuProfiler;
+int gGpuProfilerLogFrames = 300;   // frames between "[gpu]" log lines, 0 for none
+
+static void GpuProfilerResolve(int slot) {
+    GpuProfiler& p = g_gpuProfiler;
+    if (!p.pending[slot]) return;
+    p.pending[slot] = false;
+
+    // The frame scope's end query is issued last; once it's in, all are.
+    GLint available = 0;
+    glGetQueryObjectiv(p.queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) { ++p.dropped; return; }
+
+    for (int s = 0; s < p.scopeCount; ++s) {
+        if (!p.issued[slot][s]) continue;
+        GLuint64 t0 = 0, t1 = 0;
+        glGetQueryObjectui64v(p.queries[slot][s * 2 + 0], GL_QUERY_RESULT, &t0);
+        glGetQueryObjectui64v(p.queries[slot][s * 2 + 1], GL_QUERY_RESULT, &t1);
+        const float ms = (t1 > t0) ? (float)((double)(t1 - t0) * 1e-6) : 0.f;
+        p.lastMs[s] = ms;
+        p.history[s][p.historyHead[s]] = ms;
+        p.historyHead[s] = (p.historyHead[s] + 1) % GPU_PROFILER_WINDOW;
+        if (p.historyCount[s] < GPU_PROFILER_WINDOW) ++p.historyCount[s];
+    }
+    ++p.resolved;
+}
+
+// Averages for scope i (0 = frame); false past the last scope seen.
+bool GpuProfilerGetScope(int i, GpuScopeStats* out) {
+    const GpuProfiler& p = g_gpuProfiler;
+    if (i < 0 || i >= p.scopeCount) return false;
+    out->name = p.names[i];
+    out->lastMs = p.lastMs[i];
+    out->samples = p.historyCount[i];
+    float sum = 0.f, mx = 0.f;
+    for (int k = 0; k < p.historyCount[i]; ++k) {
+        sum += p.history[i][k];
+        mx = std::max(mx, p.history[i][k]);
+    }
+    out->avgMs = p.historyCount[i] ? sum / (float)p.historyCount[i] : 0.f;
+    out->maxMs = mx;
+    return true;
+}
+int GpuProfilerScopeCount() { return g_gpuProfiler.scopeCount; }
+
+// Returns a handle for GpuScopeEnd, or -1 with no timer queries or when all
+// scope slots are taken. Each name once per frame; names must outlive the profiler.
+int GpuScopeBegin(const char* name) {
+    GpuProfiler& p = g_gpuProfiler;
+    if (!p.supported) return -1;
+    int s = 0;
+    while (s < p.scopeCount && p.names[s] != name && std::strcmp(p.names[s], name) != 0) ++s;
+    if (s == p.scopeCount) {
+        if (p.scopeCount == GPU_PROFILER_SCOPES) return -1;
+        p.names[p.scopeCount++] = name;
+    }
+    glQueryCounter(p.queries[p.frame][s * 2 + 0], GL_TIMESTAMP);
+    return s;
+}
+void GpuScopeEnd(int scope) {
+    GpuProfiler& p = g_gpuProfiler;
+    if (scope < 0 || !p.supported) return;
+    glQueryCounter(p.queries[p.frame][scope * 2 + 1], GL_TIMESTAMP);
+    p.issued[p.frame][scope] = true;
+}
+
+// Brackets everything the frame submits; reads the slot it's about to reuse.
+void BeginGpuFrame() {
+    GpuProfiler& p = g_gpuProfiler;
+    if (!p.ready) {
+        p.ready = true;
+        p.supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+        if (p.supported) glGenQueries(GPU_PROFILER_FRAMES * GPU_PROFILER_SCOPES * 2, &p.queries[0][0]);
+        std::fprintf(stderr, "[gpu] timer queries %s\n", p.supported ? "on" : "unavailable");
+    }
+    if (!p.supported) return;
+    GpuProfilerResolve(p.frame);
+    for (int s = 0; s < GPU_PROFILER_SCOPES; ++s) p.issued[p.frame][s] = false;
+    GpuScopeBegin("frame");
+}
+
+void EndGpuFrame() {
+    GpuProfiler& p = g_gpuProfiler;
+    if (!p.supported) return;
+    GpuScopeEnd(0);
+    p.pending[p.frame] = true;
+    p.frame = (p.frame + 1) % GPU_PROFILER_FRAMES;
+
+    if (gGpuProfilerLogFrames > 0 && p.resolved >= p.loggedAt + (unsigned long long)gGpuProfilerLogFrames) {
+        p.loggedAt = p.resolved;
+        char line[512];
+        int n = std::snprintf(line, sizeof(line), "[gpu]");
+        GpuScopeStats st;
+        for (int s = 1; s <= p.scopeCount && n < (int)sizeof(line); ++s) {
+            if (!GpuProfilerGetScope(s % p.scopeCount, &st)) continue;   // frame total last
+            n += std::snprintf(line + n, sizeof(line) - n, " %s %.3f ms (max %.3f)", st.name, st.avgMs, st.maxMs);
+        }
+        std::fprintf(stderr, "%s, avg of %d frames, %d dropped\n", line, st.samples, p.dropped);
+    }
+}
+
+void DestroyGpuProfiler() {
+    GpuProfiler& p = g_gpuProfiler;
+    if (p.supported) glDeleteQueries(GPU_PROFILER_FRAMES * GPU_PROFILER_SCOPES * 2, &p.queries[0][0]);
+    p.supported = false;
+    p.ready = false;
 }
 
 // --------------- Draw ---------------
 void DrawTriangles(GLint first, GLsizei count) { glDrawArrays(GL_TRIANGLES, first, count); }
-void DrawIndexedTriangles(GLsizei indexCount, void* offset) {
-    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, offset);
+// indexType is GL_UNSIGNED_SHORT or GL_UNSIGNED_INT; indices are relative to baseVertex.
+void DrawIndexedTriangles(GLsizei indexCount, GLenum indexType, size_t byteOffset, GLint baseVertex) {
+    glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, indexType, (void*)byteOffset, baseVertex);
 }
 
 // --------------- Shader helpers ---------------
@@ -220,11 +959,13 @@ GLuint CompileShader(GLenum type, const char* source_utf8) {
     return s;
 }
 
-GLuint LinkProgram(GLuint vs, GLuint fs) {
+// retrievable asks the driver to keep the linked binary for glGetProgramBinary.
+GLuint LinkProgram(GLuint vs, GLuint fs, bool retrievable = false) {
     if (!vs || !fs) return 0;
     GLuint p = glCreateProgram();
     glAttachShader(p, vs);
     glAttachShader(p, fs);
+    if (retrievable) glProgramParameteri(p, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(p);
     GLint ok = 0; glGetProgramiv(p, GL_LINK_STATUS, &ok);
     if (!ok) {
@@ -244,32 +985,25 @@ GLuint CreateTexture2D(int width, int height, GLenum internalFormat, GLenum srcF
     GLint wrapS = GL_CLAMP_TO_EDGE, GLint wrapT = GL_CLAMP_TO_EDGE) {
     GLuint tex = 0;
     glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
+    BindTexture2D(0, tex);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, srcFormat, srcType, pixels);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
-    glBindTexture(GL_TEXTURE_2D, 0);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     return tex;
 }
 
-void BindTexture2D(GLuint unit, GLuint tex) {
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, tex);
-}
-
 void UpdateTexture2D(GLuint tex, int width, int height, GLenum srcFormat, GLenum srcType, const void* pixels) {
-    glBindTexture(GL_TEXTURE_2D, tex);
+    BindTexture2D(0, tex);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, srcFormat, srcType, pixels);
-    glBindTexture(GL_TEXTURE_2D, 0);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
-void DestroyTexture(GLuint tex) { if (tex) glDeleteTextures(1, &tex); }
+void DestroyTexture(GLuint tex) { if (tex) { GLStateForgetTexture(tex); glDeleteTextures(1, &tex); } }
 
 GLuint LoadTextureRGBA8_FromFile(const char* path, bool flipY = true) {
     if (flipY) stbi_set_flip_vertically_on_load(1);
@@ -291,24 +1025,224 @@ GLuint CreateProgramFromSources(const char* vsSrc, const char* fsSrc) {
     return prog;
 }
 
+// --------------- Program binary cache ---------------
+// Linked programs are saved with glGetProgramBinary and reloaded with
+// glProgramBinary on the next launch. A file is named by a hash of both
+// sources, the GL vendor/renderer/version strings and the driver's binary
+// formats, so editing a shader or updating the driver just misses. The file
+// header repeats the key and records the blob's format and length; a file
+// that fails those checks, or a binary the driver refuses to link, is
+// rejected and the program is compiled from source and saved again.
+#define PROGRAM_CACHE_MAGIC   0x43425052u   // "RPBC"
+#define PROGRAM_CACHE_VERSION 1u
+
+struct ProgramCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+struct ProgramCache {
+    bool     ready;
+    bool     supported;
+    uint64_t driverHash;
+    std::vector<GLint> formats;
+    int      hits;
+    int      misses;      // no file for the key
+    int      rejected;    // file present but unusable
+    int      saveFailures;
+    ProgramCache() : ready(false), supported(false), driverHash(0), hits(0), misses(0), rejected(0), saveFailures(0) {}
+};
+ProgramCache g_programCache;
+const char* gProgramCacheDir = "shadercache";   // must exist; nullptr or "" disables the cache
+
+static uint64_t HashBytes(uint64_t h, const void* data, size_t bytes) {
+    const unsigned char* b = (const unsigned char*)data;
+    for (size_t i = 0; i < bytes; ++i) h = (h ^ b[i]) * 0x100000001B3ull;
+    return h;
+}
+
+static uint64_t HashString(uint64_t h, const char* s) {
+    if (!s) s = "";
+    return HashBytes(h, s, std::strlen(s) + 1);   // the terminator separates fields
+}
+
+static void ProgramCacheInit() {
+    ProgramCache& c = g_programCache;
+    if (c.ready) return;
+    c.ready = true;
+    if (!(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)) return;
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+    if (count <= 0) return;
+    c.formats.resize((size_t)count);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, c.formats.data());
+
+    uint64_t h = 0xCBF29CE484222325ull;
+    h = HashString(h, (const char*)glGetString(GL_VENDOR));
+    h = HashString(h, (const char*)glGetString(GL_RENDERER));
+    h = HashString(h, (const char*)glGetString(GL_VERSION));
+    h = HashBytes(h, c.formats.data(), c.formats.size() * sizeof(GLint));
+    c.driverHash = h;
+    c.supported = true;
+}
+
+static bool ProgramCacheEnabled() {
+    if (!gProgramCacheDir || !*gProgramCacheDir) return false;
+    ProgramCacheInit();
+    return g_programCache.supported;
+}
+
+static void ProgramCachePath(uint64_t key, char* out, size_t outSize) {
+    std::snprintf(out, outSize, "%s/%016llx.bin", gProgramCacheDir, (unsigned long long)key);
+}
+
+static bool ProgramCacheFormatKnown(GLenum format) {
+    const std::vector<GLint>& f = g_programCache.formats;
+    return std::find(f.begin(), f.end(), (GLint)format) != f.end();
+}
+
+// 0 when there is no usable entry; counts the hit, miss or rejection.
+static GLuint ProgramCacheLoad(uint64_t key) {
+    ProgramCache& c = g_programCache;
+    char path[512];
+    ProgramCachePath(key, path, sizeof(path));
+    FILE* f = std::fopen(path, "rb");
+    if (!f) { ++c.misses; return 0; }
+
+    ProgramCacheHeader hdr = {};
+    std::vector<unsigned char> blob;
+    bool ok = std::fread(&hdr, sizeof(hdr), 1, f) == 1 && hdr.magic == PROGRAM_CACHE_MAGIC &&
+        hdr.version == PROGRAM_CACHE_VERSION && hdr.key == key && hdr.length > 0 && ProgramCacheFormatKnown(hdr.format);
+    if (ok) {
+        blob.resize(hdr.length);
+        ok = std::fread(blob.data(), 1, blob.size(), f) == blob.size();
+    }
+    std::fclose(f);
+
+    GLuint p = 0;
+    if (ok) {
+        p = glCreateProgram();
+        glProgramBinary(p, (GLenum)hdr.format, blob.data(), (GLsizei)blob.size());
+        GLint linked = 0; glGetProgramiv(p, GL_LINK_STATUS, &linked);
+        if (!linked) { glDeleteProgram(p); p = 0; }
+    }
+    if (!p) {
+        ++c.rejected;
+        std::fprintf(stderr, "[shader cache] %s rejected, compiling from source\n", path);
+        return 0;
+    }
+    ++c.hits;
+    return p;
+}
+
+static void ProgramCacheSave(uint64_t key, GLuint program) {
+    ProgramCache& c = g_programCache;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) { ++c.saveFailures; return; }
+    std::vector<unsigned char> blob((size_t)length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, blob.data());
+    if (written <= 0) { ++c.saveFailures; return; }
+
+    ProgramCacheHeader hdr = {};
+    hdr.magic = PROGRAM_CACHE_MAGIC;
+    hdr.version = PROGRAM_CACHE_VERSION;
+    hdr.key = key;
+    hdr.format = (uint32_t)format;
+    hdr.length = (uint32_t)written;
+    char path[512];
+    ProgramCachePath(key, path, sizeof(path));
+    FILE* f = std::fopen(path, "wb");
+    if (!f) { ++c.saveFailures; return; }
+    // A short write leaves a file whose length check fails, so it is rebuilt next launch.
+    bool ok = std::fwrite(&hdr, sizeof(hdr), 1, f) == 1 && std::fwrite(blob.data(), 1, (size_t)written, f) == (size_t)written;
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) ++c.saveFailures;
+}
+
+// CreateProgramFromSources, going through the binary cache when the driver
+// supports it.
+GLuint CreateProgramCached(const char* vsSrc, const char* fsSrc) {
+    if (!vsSrc || !fsSrc) return 0;
+    if (!ProgramCacheEnabled()) return CreateProgramFromSources(vsSrc, fsSrc);
+
+    uint64_t key = g_programCache.driverHash;
+    key = HashString(key, vsSrc);
+    key = HashString(key, fsSrc);
+    GLuint prog = ProgramCacheLoad(key);
+    if (prog) return prog;
+
+    GLuint vs = CompileShader(GL_VERTEX_SHADER, vsSrc);
+    GLuint fs = CompileShader(GL_FRAGMENT_SHADER, fsSrc);
+    prog = LinkProgram(vs, fs, true);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    if (prog) ProgramCacheSave(key, prog);
+    return prog;
+}
+
+// --------------- Shader permutations ---------------
+// Variants of one source: defines (newline separated "#define X" lines)
+// go in right after the #version line, and #line keeps compile errors
+// pointing at the file's own line numbers.
+std::string ShaderSourceWithDefines(const std::string& src, const std::string& defines) {
+    if (defines.empty()) return src;
+    size_t at = 0;
+    if (src.compare(0, 8, "#version") == 0) {
+        at = src.find('\n');
+        at = (at == std::string::npos) ? src.size() : at + 1;
+    }
+    const int nextLine = (at > 0) ? 2 : 1;
+    char line[32];
+    std::snprintf(line, sizeof(line), "#line %d\n", nextLine);
+    std::string out;
+    out.reserve(src.size() + defines.size() + 16);
+    out.append(src, 0, at);
+    if (at > 0 && src[at - 1] != '\n') out += '\n';
+    out += defines;
+    if (defines[defines.size() - 1] != '\n') out += '\n';
+    out += line;
+    out.append(src, at, std::string::npos);
+    return out;
+}
+
+// The defines simple_uv.vert expects for a MeshShaderKey.
+std::string MeshShaderDefines(int key) {
+    std::string defines;
+    if (key & MESH_SHADER_SKINNED) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "#define SKINNED\n#define MAX_INFLUENCES %d\n", MeshShaderInfluences(key));
+        defines += buf;
+    }
+    if (key & MESH_SHADER_INSTANCED) defines += "#define INSTANCED\n";
+    return defines;
+}
+
 void InitMeshProgram(GLuint program) {
     if (!program) return;
-    glUseProgram(program);
+    UseProgram(program);
     GLint loc = glGetUniformLocation(program, "uTex");
     if (loc >= 0) glUniform1i(loc, 0);
+    loc = glGetUniformLocation(program, "uDrawRecords");
+    if (loc >= 0) glUniform1i(loc, DRAW_RECORD_UNIT);
     BindUBOsForMesh(program);
-    glUseProgram(0);
+    UseProgram(0);
 }
 
 void InitPostProgram(GLuint program) {
     if (!program) return;
-    glUseProgram(program);
+    UseProgram(program);
     GLint loc = glGetUniformLocation(program, "uScene");
     if (loc >= 0) glUniform1i(loc, 0);
     BindUBOsForVisualizer(program);
-    glUseProgram(0);
+    UseProgram(0);
 }
 
 void DestroyProgram(GLuint& program) {
-    if (program) { glDeleteProgram(program); program = 0; }
+    if (program) { GLStateForgetProgram(program); glDeleteProgram(program); program = 0; }
 }
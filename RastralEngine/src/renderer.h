@@ -2,10 +2,13 @@
 #define RENDERER_H
 
 #include <cstring>
+#include <cstdint>
 
 // ---------------- UBO layouts ----------------
 struct PerFrameUBO {
-    float uProjView[16];
+    float   uProjView[16];
+    int32_t uDrawRecordBase;   // texel of this frame's first DrawRecord, multi-draw only
+    int32_t _pad[3];
 };
 struct PerDrawUBO {
     float uModel[16];
@@ -23,16 +26,78 @@ struct VizParamsUBO {
     float uRage;
     float uLevelsA[4];
     float uLevelLead;
-    float _pad2[3];
+    float _pad1;
+    float _pad2;
+    float _pad3;
+    float uSceneUV[4];  // xy: scene texcoord scale to its active rect, zw: clamp for bilinear taps
 };
 
-// NEW: Skin palette UBO (binding = 3). 128 bones max is typical.
+// Skin palette window (binding = 3), bound per draw at a palette's offset
+// in the uniform ring. 128 bones max is typical.
 struct SkinUBO {
-    float uBones[128][16]; // row-major 4x4 per bone
-    int   uBoneCount;      // optional, not required by shader
-    int   _pad[3];
+    float uBones[128][16]; // column-major 4x4 per bone
 };
 
+// ---------------- Multi-draw ----------------
+// Per-draw data for the INSTANCED mesh variant, written to the uniform ring
+// and read through an RGBA32F texture buffer over it, six texels a record.
+// A draw finds its record through instanced attribute 4, which holds
+// 0, 1, 2, ... so each command's baseInstance picks the record.
+struct DrawRecord {
+    float   model[16];
+    float   tint[4];
+    int32_t paletteTexel;   // first texel of the bone palette, -1 for none
+    int32_t boneCount;
+    int32_t _pad[2];
+};
+
+// glMultiDrawElementsIndirect command.
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t  baseVertex;
+    uint32_t baseInstance;
+};
+
+// ---------------- Vertex layouts ----------------
+// Skinned mesh vertex (VAO attribs 0..3): joints go through
+// glVertexAttribIPointer, weights are unorm8 summing to exactly 255.
+struct SkinnedVertex {
+    float    pos[3];
+    uint16_t uv[2];       // half float
+    uint8_t  joints[4];
+    uint8_t  weights[4];
+};
+
+// Static mesh vertex (VAO attribs 0..1), positions already in model space.
+struct StaticVertex {
+    float    pos[3];
+    uint16_t uv[2];       // half float
+};
+
+// ---------------- Mesh shader permutations ----------------
+// simple_uv is compiled once per feature set with #defines (SKINNED,
+// MAX_INFLUENCES, INSTANCED); a key packs the set and indexes the programs.
+// INSTANCED variants take uModel, uTint and the palette from DrawRecords.
+#define MESH_SHADER_SKINNED          1
+#define MESH_SHADER_INSTANCED        2
+#define MESH_SHADER_INFLUENCE_SHIFT  2    // bits 2..3: influences - 1, skinned keys only
+#define MESH_SHADER_PERMUTATIONS     16
+
+static inline int MeshShaderKey(bool skinned, int influences, bool instanced) {
+    int key = instanced ? MESH_SHADER_INSTANCED : 0;
+    if (skinned) {
+        influences = influences < 1 ? 1 : (influences > 4 ? 4 : influences);
+        key |= MESH_SHADER_SKINNED | ((influences - 1) << MESH_SHADER_INFLUENCE_SHIFT);
+    }
+    return key;
+}
+
+static inline int MeshShaderInfluences(int key) {
+    return (key & MESH_SHADER_SKINNED) ? ((key >> MESH_SHADER_INFLUENCE_SHIFT) & 3) + 1 : 0;
+}
+
 // ---------------- RenderTarget ----------------
 struct RenderTarget {
     unsigned int fbo;
@@ -40,15 +105,12 @@ struct RenderTarget {
     unsigned int depth;
     int    w;
     int    h;
+    int    vw;   // rectangle in use from the origin (dynamic resolution), <= w, h
+    int    vh;
 };
 
 // ---------------- Globals ----------------
 int g_view_w = 1280;
 int g_view_h = 720;
 
-unsigned int g_uboPerFrame = 0;
-unsigned int g_uboPerDraw = 0;
-unsigned int g_uboViz = 0;
-unsigned int g_uboSkin = 0;  // NEW
-
 #endif